@@ -0,0 +1,134 @@
+#pragma once
+
+#include "shared.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+#ifndef NDEBUG
+#include <cstdio>
+#include <cstdlib>
+#endif
+
+// Bump allocator for request-scoped object graphs. Freeing is a no-op; all memory goes back
+// at once when the arena is destroyed. Allocation is not thread-safe, but blocks may be
+// released from any thread. Blocks are always counted, so the layout does not depend on
+// NDEBUG; debug builds abort if the arena is destroyed while any SharedPtr or WeakPtr still
+// points into it.
+class Arena {
+public:
+    static constexpr size_t kDefaultChunkSize = size_t(64) << 10;
+
+    explicit Arena(size_t chunk_size = kDefaultChunkSize) : chunk_size_(chunk_size) {
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena() {
+#ifndef NDEBUG
+        size_t live = blocks_allocated_ - blocks_freed_.load(std::memory_order_acquire);
+        if (live != 0) {
+            std::fprintf(stderr, "Arena destroyed with %zu control blocks still referenced\n",
+                         live);
+            std::abort();
+        }
+#endif
+        while (chunks_ != nullptr) {
+            Chunk* next = chunks_->next;
+            ::operator delete(chunks_);
+            chunks_ = next;
+        }
+    }
+
+    void* Allocate(size_t bytes, size_t alignment) {
+        uintptr_t start = (current_ + alignment - 1) & ~(alignment - 1);
+        if (current_ == 0 || start + bytes > end_) {
+            NewChunk(bytes + alignment);
+            start = (current_ + alignment - 1) & ~(alignment - 1);
+        }
+        current_ = start + bytes;
+        bytes_allocated_ += bytes;
+        ++blocks_allocated_;
+        return reinterpret_cast<void*>(start);
+    }
+
+    void Deallocate(void*) {
+        blocks_freed_.fetch_add(1, std::memory_order_release);
+    }
+
+    size_t BytesAllocated() const {
+        return bytes_allocated_;
+    }
+
+private:
+    struct Chunk {
+        Chunk* next;
+    };
+
+    void NewChunk(size_t min_bytes) {
+        size_t size = sizeof(Chunk) + (min_bytes > chunk_size_ ? min_bytes : chunk_size_);
+        auto chunk = static_cast<Chunk*>(::operator new(size));
+        chunk->next = chunks_;
+        chunks_ = chunk;
+        current_ = reinterpret_cast<uintptr_t>(chunk + 1);
+        end_ = reinterpret_cast<uintptr_t>(chunk) + size;
+    }
+
+    size_t chunk_size_;
+    Chunk* chunks_ = nullptr;
+    uintptr_t current_ = 0;
+    uintptr_t end_ = 0;
+    size_t bytes_allocated_ = 0;
+    size_t blocks_allocated_ = 0;
+    std::atomic<size_t> blocks_freed_ = 0;
+};
+
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    ArenaAllocator(Arena& arena) : arena_(&arena) {
+    }
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena_) {
+    }
+
+    T* allocate(size_t n) {
+        if (n > SIZE_MAX / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        return static_cast<T*>(arena_->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* ptr, size_t) {
+        arena_->Deallocate(ptr);
+    }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const {
+        return arena_ == other.arena_;
+    }
+
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const {
+        return arena_ != other.arena_;
+    }
+
+private:
+    Arena* arena_;
+
+    template <typename U>
+    friend class ArenaAllocator;
+};
+
+// The object is destroyed when the last SharedPtr goes; its memory stays until the arena dies.
+template <typename T, typename Policy = SingleThreaded, typename... Args>
+SharedPtr<T, Policy> MakeArenaShared(Arena& arena, Args&&... args) {
+    return AllocateShared<T, Policy>(ArenaAllocator<T>(arena), std::forward<Args>(args)...);
+}
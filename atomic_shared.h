@@ -0,0 +1,156 @@
+#pragma once
+
+#include "shared.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// The slot word keeps a pointer to an immutable node together with a count of readers
+// currently inside Load (split reference count). A writer that swaps a node out transfers
+// those pending readers into the node's own count, so readers never wait for writers.
+template <typename T>
+class AtomicSharedPtr {
+public:
+    using Value = SharedPtr<T, MultiThreaded>;
+
+    AtomicSharedPtr() = default;
+
+    AtomicSharedPtr(Value value) : word_(Pack(MakeNode(std::move(value)))) {
+    }
+
+    AtomicSharedPtr(const AtomicSharedPtr&) = delete;
+    AtomicSharedPtr& operator=(const AtomicSharedPtr&) = delete;
+
+    ~AtomicSharedPtr() {
+        Release(Unpack(word_.load(std::memory_order_acquire)));
+    }
+
+    Value Load() const {
+        if (Unpack(word_.load(std::memory_order_acquire)) == nullptr) {
+            return Value();
+        }
+        Node* node = Acquire();
+        Value result = node != nullptr ? node->value : Value();
+        Unacquire(node);
+        return result;
+    }
+
+    void Store(Value desired) {
+        Exchange(std::move(desired));
+    }
+
+    Value Exchange(Value desired) {
+        uintptr_t old = word_.exchange(Pack(MakeNode(std::move(desired))), std::memory_order_acq_rel);
+        Node* node = Unpack(old);
+        if (node == nullptr) {
+            return Value();
+        }
+        Value result = node->value;
+        Transfer(node, LocalCount(old));
+        return result;
+    }
+
+    bool CompareExchange(Value& expected, Value desired) {
+        Node* fresh = MakeNode(std::move(desired));
+        while (true) {
+            uintptr_t current = word_.fetch_add(kOneLocal, std::memory_order_acquire) + kOneLocal;
+            Node* node = Unpack(current);
+            if (!Holds(node, expected)) {
+                expected = node != nullptr ? node->value : Value();
+                Unacquire(node);
+                delete fresh;
+                return false;
+            }
+            while (Unpack(current) == node) {
+                if (word_.compare_exchange_weak(current, Pack(fresh), std::memory_order_acq_rel,
+                                                std::memory_order_acquire)) {
+                    Transfer(node, LocalCount(current));
+                    Release(node);
+                    return true;
+                }
+            }
+            Release(node);
+        }
+    }
+
+private:
+    struct Node {
+        explicit Node(Value v) : value(std::move(v)) {
+        }
+
+        std::atomic<size_t> refs = 1;
+        const Value value;
+    };
+
+    static_assert(sizeof(uintptr_t) == 8, "AtomicSharedPtr packs a local count into pointer bits");
+
+    static constexpr int kLocalShift = 48;
+    static constexpr uintptr_t kOneLocal = uintptr_t(1) << kLocalShift;
+    static constexpr uintptr_t kPointerMask = kOneLocal - 1;
+
+    static Node* MakeNode(Value value) {
+        if (value.block_ == nullptr && value.ptr_ == nullptr) {
+            return nullptr;
+        }
+        return new Node(std::move(value));
+    }
+
+    static uintptr_t Pack(Node* node) {
+        uintptr_t word = reinterpret_cast<uintptr_t>(node);
+        assert((word & ~kPointerMask) == 0);
+        return word;
+    }
+
+    static Node* Unpack(uintptr_t word) {
+        return reinterpret_cast<Node*>(word & kPointerMask);
+    }
+
+    static size_t LocalCount(uintptr_t word) {
+        return word >> kLocalShift;
+    }
+
+    static bool Holds(Node* node, const Value& expected) {
+        if (node == nullptr) {
+            return expected.block_ == nullptr && expected.ptr_ == nullptr;
+        }
+        return node->value.block_ == expected.block_ && node->value.ptr_ == expected.ptr_;
+    }
+
+    // The slot's own reference is dropped and `local` pending readers take its place.
+    static void Transfer(Node* node, size_t local) {
+        if (node == nullptr) {
+            return;
+        }
+        if (node->refs.fetch_add(local - 1, std::memory_order_acq_rel) + local - 1 == 0) {
+            delete node;
+        }
+    }
+
+    static void Release(Node* node) {
+        Transfer(node, 0);
+    }
+
+    Node* Acquire() const {
+        return Unpack(word_.fetch_add(kOneLocal, std::memory_order_acquire) + kOneLocal);
+    }
+
+    void Unacquire(Node* node) const {
+        uintptr_t current = word_.load(std::memory_order_relaxed);
+        while (Unpack(current) == node) {
+            // Empty slots are not reference counted, so a reader may find its increment
+            // already discarded by an intervening writer.
+            if (node == nullptr && LocalCount(current) == 0) {
+                return;
+            }
+            if (word_.compare_exchange_weak(current, current - kOneLocal, std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+                return;
+            }
+        }
+        Release(node);
+    }
+
+    mutable std::atomic<uintptr_t> word_ = 0;
+};
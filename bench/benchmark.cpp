@@ -0,0 +1,961 @@
+// Microbenchmarks for the smart pointers in this repository and their std counterparts.
+//
+//   benchmark [--format csv|json] [--threads N] [--iterations N] [--filter SUBSTRING]
+//             [--table-mib N]
+//
+// Each case is run once single-threaded and once on N threads (some sweep 1, 2, 4, ... N);
+// every thread performs the given number of iterations and the reported time is wall-clock
+// nanoseconds per operation per thread. Cases whose operations can fail also report the
+// fraction that succeeded in hit_rate.
+
+#include "arena.h"
+#include "atomic_shared.h"
+#include "biased.h"
+#include "epoch.h"
+#include "hazard_pointer.h"
+#include "intrusive.h"
+#include "mapped_array.h"
+#include "refcount_log.h"
+#include "relocation.h"
+#include "shared.h"
+#include "slab_allocator.h"
+#include "unique.h"
+#include "weak.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+template <typename T>
+void DoNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct Payload {
+    explicit Payload(int v) : value(v) {
+    }
+
+    int value;
+};
+
+struct AtomicIntrusivePayload : ThreadSafeRefCounted<AtomicIntrusivePayload> {
+    explicit AtomicIntrusivePayload(int v) : value(v) {
+    }
+
+    int value;
+};
+
+struct IntrusivePayload : SimpleRefCounted<IntrusivePayload> {
+    explicit IntrusivePayload(int v) : value(v) {
+    }
+
+    int value;
+};
+
+struct DeferredPayload : DeferredRefCounted<DeferredPayload> {
+    explicit DeferredPayload(int v) : value(v) {
+    }
+
+    int value;
+};
+
+struct HazardPayload : RefCounted<HazardPayload, MultiThreaded, HazardDelete<>> {
+    explicit HazardPayload(int v) : value(v) {
+    }
+
+    int value;
+};
+
+struct Strategy {
+    virtual ~Strategy() = default;
+
+    virtual int Apply(int x) const = 0;
+};
+
+struct AddStrategy : Strategy {
+    explicit AddStrategy(int v) : delta(v) {
+    }
+
+    int Apply(int x) const override {
+        return x + delta;
+    }
+
+    int delta;
+};
+
+// The baseline for IntrusivePtr: a hand-written count with no wrapper at all.
+struct RawCounted {
+    explicit RawCounted(int v) : value(v) {
+    }
+
+    std::atomic<size_t> refs = 1;
+    int value;
+};
+
+void RawRetain(RawCounted* object) {
+    object->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RawRelease(RawCounted* object) {
+    if (object->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete object;
+    }
+}
+
+constexpr size_t kContainerSize = 1024;
+constexpr size_t kChainLength = size_t(1) << 20;
+
+struct Case {
+    std::string name;
+    std::string implementation;
+    // Runs the given number of operations on one thread; setup and teardown run once per
+    // measurement around all threads and manage state the threads share.
+    std::function<void(size_t iterations, size_t thread)> run;
+    std::function<void(size_t threads)> setup = [](size_t) {};
+    std::function<void()> teardown = [] {};
+    // Runs at 1, 2, 4, ... threads up to --threads instead of only at 1 and --threads.
+    bool sweep_threads = false;
+    // Fraction of operations that succeeded, for cases where that varies; read after teardown.
+    std::function<double()> hit_rate = nullptr;
+};
+
+std::vector<Case>& Registry() {
+    static std::vector<Case> cases;
+    return cases;
+}
+
+void Register(Case c) {
+    Registry().push_back(std::move(c));
+}
+
+// --- Construction and destruction --------------------------------------------------------
+
+void RegisterConstruction() {
+    Register({"construct_destroy", "UniquePtr", [](size_t n, size_t) {
+                  for (size_t i = 0; i < n; ++i) {
+                      UniquePtr<Payload> p(new Payload(int(i)));
+                      DoNotOptimize(p.Get());
+                  }
+              }});
+    Register({"construct_destroy", "std::unique_ptr", [](size_t n, size_t) {
+                  for (size_t i = 0; i < n; ++i) {
+                      auto p = std::make_unique<Payload>(int(i));
+                      DoNotOptimize(p.get());
+                  }
+              }});
+    Register({"construct_destroy", "MakeShared<Single>", [](size_t n, size_t) {
+                  for (size_t i = 0; i < n; ++i) {
+                      auto p = MakeShared<Payload>(int(i));
+                      DoNotOptimize(p.Get());
+                  }
+              }});
+    Register({"construct_destroy", "MakeShared<Multi>", [](size_t n, size_t) {
+                  for (size_t i = 0; i < n; ++i) {
+                      auto p = MakeShared<Payload, MultiThreaded>(int(i));
+                      DoNotOptimize(p.Get());
+                  }
+              }});
+    Register({"construct_destroy", "MakePooledShared<Multi>", [](size_t n, size_t) {
+                  for (size_t i = 0; i < n; ++i) {
+                      auto p = MakePooledShared<Payload, MultiThreaded>(int(i));
+                      DoNotOptimize(p.Get());
+                  }
+              }});
+    Register({"construct_destroy", "MakeArenaShared<Single>", [](size_t n, size_t) {
+                  Arena arena;
+                  for (size_t i = 0; i < n; ++i) {
+                      auto p = MakeArenaShared<Payload>(arena, int(i));
+                      DoNotOptimize(p.Get());
+                  }
+              }});
+    Register({"construct_destroy", "SharedPtr(new)", [](size_t n, size_t) {
+                  for (size_t i = 0; i < n; ++i) {
+                      SharedPtr<Payload, MultiThreaded> p(new Payload(int(i)));
+                      DoNotOptimize(p.Get());
+                  }
+              }});
+    Register({"construct_destroy", "std::make_shared", [](size_t n, size_t) {
+                  for (size_t i = 0; i < n; ++i) {
+                      auto p = std::make_shared<Payload>(int(i));
+                      DoNotOptimize(p.get());
+                  }
+              }});
+    Register({"construct_destroy", "std::shared_ptr(new)", [](size_t n, size_t) {
+                  for (size_t i = 0; i < n; ++i) {
+                      std::shared_ptr<Payload> p(new Payload(int(i)));
+                      DoNotOptimize(p.get());
+                  }
+              }});
+    Register({"construct_destroy", "MakeIntrusive", [](size_t n, size_t) {
+                  for (size_t i = 0; i < n; ++i) {
+                      auto p = MakeIntrusive<AtomicIntrusivePayload>(int(i));
+                      DoNotOptimize(p.Get());
+                  }
+              }});
+    Register({"construct_destroy_small", "UniquePtr", [](size_t n, size_t) {
+                  for (size_t i = 0; i < n; ++i) {
+                      UniquePtr<Strategy> p(new AddStrategy(int(i)));
+                      DoNotOptimize(p->Apply(1));
+                  }
+              }});
+    Register({"construct_destroy_small", "InlineUniquePtr", [](size_t n, size_t) {
+                  for (size_t i = 0; i < n; ++i) {
+                      auto p = MakeInlineUnique<Strategy, AddStrategy>(int(i));
+                      DoNotOptimize(p->Apply(1));
+                  }
+              }});
+    Register({"construct_destroy", "raw refcount", [](size_t n, size_t) {
+                  for (size_t i = 0; i < n; ++i) {
+                      auto p = new RawCounted(int(i));
+                      DoNotOptimize(p);
+                      RawRelease(p);
+                  }
+              }});
+}
+
+// --- Copy, move and destroy of a live object ---------------------------------------------
+//
+// Every thread copies the same object, so the multi-threaded runs measure contention on
+// one counter.
+
+template <typename Ptr>
+Ptr& SharedSlot() {
+    static Ptr slot;
+    return slot;
+}
+
+template <typename Ptr, typename Make>
+void RegisterCopy(const char* implementation, Make make) {
+    Register({"copy_destroy", implementation,
+              [](size_t n, size_t) {
+                  const Ptr& source = SharedSlot<Ptr>();
+                  for (size_t i = 0; i < n; ++i) {
+                      Ptr copy = source;
+                      DoNotOptimize(copy);
+                  }
+              },
+              [make](size_t) { SharedSlot<Ptr>() = make(); },
+              [] { SharedSlot<Ptr>() = Ptr(); }});
+}
+
+void RegisterCopies() {
+    RegisterCopy<SharedPtr<Payload, MultiThreaded>>(
+        "SharedPtr<Multi>", [] { return MakeShared<Payload, MultiThreaded>(1); });
+    RegisterCopy<std::shared_ptr<Payload>>("std::shared_ptr",
+                                           [] { return std::make_shared<Payload>(1); });
+    RegisterCopy<IntrusivePtr<AtomicIntrusivePayload>>(
+        "IntrusivePtr<Atomic>", [] { return MakeIntrusive<AtomicIntrusivePayload>(1); });
+    RegisterCopy<IntrusivePtr<DeferredPayload>>(
+        "IntrusivePtr<Deferred>", [] { return MakeIntrusive<DeferredPayload>(1); });
+    Register({"copy_destroy", "raw refcount",
+              [](size_t n, size_t) {
+                  static RawCounted object(1);
+                  for (size_t i = 0; i < n; ++i) {
+                      RawRetain(&object);
+                      DoNotOptimize(object.value);
+                      object.refs.fetch_sub(1, std::memory_order_acq_rel);
+                  }
+              }});
+
+    // Biased blocks are owned by the thread that creates them, so each thread makes its own;
+    // these rows show the uncontended owner path against the other policies.
+    Register({"copy_destroy_owned", "SharedPtr<Single>", [](size_t n, size_t) {
+                  auto source = MakeShared<Payload>(1);
+                  for (size_t i = 0; i < n; ++i) {
+                      auto copy = source;
+                      DoNotOptimize(copy);
+                  }
+              }});
+    Register({"copy_destroy_owned", "SharedPtr<Biased>", [](size_t n, size_t) {
+                  auto source = MakeShared<Payload, Biased>(1);
+                  for (size_t i = 0; i < n; ++i) {
+                      auto copy = source;
+                      DoNotOptimize(copy);
+                  }
+              }});
+    Register({"copy_destroy_owned", "SharedPtr<Multi>", [](size_t n, size_t) {
+                  auto source = MakeShared<Payload, MultiThreaded>(1);
+                  for (size_t i = 0; i < n; ++i) {
+                      auto copy = source;
+                      DoNotOptimize(copy);
+                  }
+              }});
+    Register({"copy_destroy_owned", "std::shared_ptr", [](size_t n, size_t) {
+                  auto source = std::make_shared<Payload>(1);
+                  for (size_t i = 0; i < n; ++i) {
+                      auto copy = source;
+                      DoNotOptimize(copy);
+                  }
+              }});
+
+    Register({"move", "UniquePtr", [](size_t n, size_t) {
+                  UniquePtr<Payload> a(new Payload(1));
+                  for (size_t i = 0; i < n; ++i) {
+                      UniquePtr<Payload> b(std::move(a));
+                      DoNotOptimize(b.Get());
+                      a = std::move(b);
+                  }
+              }});
+    Register({"move", "std::unique_ptr", [](size_t n, size_t) {
+                  auto a = std::make_unique<Payload>(1);
+                  for (size_t i = 0; i < n; ++i) {
+                      auto b = std::move(a);
+                      DoNotOptimize(b.get());
+                      a = std::move(b);
+                  }
+              }});
+    Register({"move", "SharedPtr<Multi>", [](size_t n, size_t) {
+                  auto a = MakeShared<Payload, MultiThreaded>(1);
+                  for (size_t i = 0; i < n; ++i) {
+                      auto b = std::move(a);
+                      DoNotOptimize(b);
+                      a = std::move(b);
+                  }
+              }});
+    Register({"move", "std::shared_ptr", [](size_t n, size_t) {
+                  auto a = std::make_shared<Payload>(1);
+                  for (size_t i = 0; i < n; ++i) {
+                      auto b = std::move(a);
+                      DoNotOptimize(b);
+                      a = std::move(b);
+                  }
+              }});
+    Register({"move", "IntrusivePtr", [](size_t n, size_t) {
+                  auto a = MakeIntrusive<AtomicIntrusivePayload>(1);
+                  for (size_t i = 0; i < n; ++i) {
+                      auto b = std::move(a);
+                      DoNotOptimize(b);
+                      a = std::move(b);
+                  }
+              }});
+}
+
+// --- Dereference and container growth ----------------------------------------------------
+
+template <typename Ptr, typename Make>
+void RegisterContainer(const char* implementation, Make make) {
+    Register({"deref_sum", implementation,
+              [make](size_t n, size_t) {
+                  std::vector<Ptr> pointers;
+                  for (size_t i = 0; i < kContainerSize; ++i) {
+                      pointers.push_back(make(int(i)));
+                  }
+                  long sum = 0;
+                  for (size_t done = 0; done < n; done += kContainerSize) {
+                      for (const Ptr& p : pointers) {
+                          sum += p->value;
+                      }
+                      DoNotOptimize(sum);
+                  }
+              }});
+    Register({"container_growth", implementation,
+              [make](size_t n, size_t) {
+                  for (size_t done = 0; done < n; done += kContainerSize) {
+                      std::vector<Ptr> pointers;
+                      for (size_t i = 0; i < kContainerSize; ++i) {
+                          pointers.push_back(make(int(i)));
+                      }
+                      DoNotOptimize(pointers.data());
+                  }
+              }});
+}
+
+void RegisterContainers() {
+    RegisterContainer<UniquePtr<Payload>>(
+        "UniquePtr", [](int v) { return UniquePtr<Payload>(new Payload(v)); });
+    RegisterContainer<std::unique_ptr<Payload>>(
+        "std::unique_ptr", [](int v) { return std::make_unique<Payload>(v); });
+    RegisterContainer<SharedPtr<Payload, MultiThreaded>>(
+        "SharedPtr<Multi>", [](int v) { return MakeShared<Payload, MultiThreaded>(v); });
+    RegisterContainer<std::shared_ptr<Payload>>(
+        "std::shared_ptr", [](int v) { return std::make_shared<Payload>(v); });
+    RegisterContainer<InlineUniquePtr<Payload, sizeof(Payload)>>("InlineUniquePtr", [](int v) {
+        return MakeInlineUnique<Payload, Payload, sizeof(Payload)>(v);
+    });
+    RegisterContainer<IntrusivePtr<AtomicIntrusivePayload>>(
+        "IntrusivePtr", [](int v) { return MakeIntrusive<AtomicIntrusivePayload>(v); });
+}
+
+// --- Pointer chasing ----------------------------------------------------------------------
+//
+// A linked chain whose nodes are linked in shuffled order, so every hop is a dependent load
+// that misses the cache. Each hop reads the next pointer through Get().
+
+struct SharedChainNode {
+    SharedPtr<SharedChainNode, MultiThreaded> next;
+    int value = 1;
+};
+
+struct StdChainNode {
+    std::shared_ptr<StdChainNode> next;
+    int value = 1;
+};
+
+struct RawChainNode {
+    RawChainNode* next = nullptr;
+    int value = 1;
+};
+
+const SharedChainNode* ChainGet(const SharedPtr<SharedChainNode, MultiThreaded>& p) {
+    return p.Get();
+}
+
+const StdChainNode* ChainGet(const std::shared_ptr<StdChainNode>& p) {
+    return p.get();
+}
+
+const RawChainNode* ChainGet(const RawChainNode* p) {
+    return p;
+}
+
+template <typename Ptr>
+void RegisterChain(const char* implementation, Ptr (*make)(), void (*destroy)(Ptr&)) {
+    static std::vector<Ptr> nodes;
+    Register({"pointer_chase", implementation,
+              [](size_t n, size_t) {
+                  long sum = 0;
+                  auto node = ChainGet(nodes.front());
+                  for (size_t i = 0; i < n; ++i) {
+                      sum += node->value;
+                      node = ChainGet(node->next);
+                      if (node == nullptr) {
+                          node = ChainGet(nodes.front());
+                      }
+                  }
+                  DoNotOptimize(sum);
+              },
+              [make](size_t) {
+                  std::vector<size_t> order(kChainLength);
+                  std::iota(order.begin(), order.end(), size_t(0));
+                  std::shuffle(order.begin() + 1, order.end(), std::mt19937_64(42));
+                  for (size_t i = 0; i < kChainLength; ++i) {
+                      nodes.push_back(make());
+                  }
+                  for (size_t i = 0; i + 1 < kChainLength; ++i) {
+                      nodes[order[i]]->next = nodes[order[i + 1]];
+                  }
+              },
+              // Unlinked one by one: dropping the head would recurse down the whole chain.
+              [destroy] {
+                  for (Ptr& node : nodes) {
+                      node->next = nullptr;
+                  }
+                  for (Ptr& node : nodes) {
+                      destroy(node);
+                  }
+                  nodes.clear();
+              }});
+}
+
+void RegisterChains() {
+    RegisterChain<SharedPtr<SharedChainNode, MultiThreaded>>(
+        "SharedPtr(MakeShared)", [] { return MakeShared<SharedChainNode, MultiThreaded>(); },
+        [](SharedPtr<SharedChainNode, MultiThreaded>&) {});
+    RegisterChain<SharedPtr<SharedChainNode, MultiThreaded>>(
+        "SharedPtr(new)",
+        [] { return SharedPtr<SharedChainNode, MultiThreaded>(new SharedChainNode); },
+        [](SharedPtr<SharedChainNode, MultiThreaded>&) {});
+    RegisterChain<std::shared_ptr<StdChainNode>>(
+        "std::make_shared", [] { return std::make_shared<StdChainNode>(); },
+        [](std::shared_ptr<StdChainNode>&) {});
+    RegisterChain<RawChainNode*>(
+        "raw pointer", [] { return new RawChainNode; }, [](RawChainNode*& node) { delete node; });
+}
+
+// --- Weak references ---------------------------------------------------------------------
+
+// Threads that keep mutating shared state while the measured threads run; started from a
+// case's setup and stopped in its teardown.
+class BackgroundWriters {
+public:
+    void Start(size_t count, std::function<void(size_t round)> write) {
+        stop_.store(false);
+        for (size_t i = 0; i < count; ++i) {
+            threads_.emplace_back([this, write] {
+                for (size_t round = 0; !stop_.load(std::memory_order_relaxed); ++round) {
+                    write(round);
+                }
+            });
+        }
+    }
+
+    void Stop() {
+        stop_.store(true);
+        for (std::thread& thread : threads_) {
+            thread.join();
+        }
+        threads_.clear();
+    }
+
+private:
+    std::vector<std::thread> threads_;
+    std::atomic<bool> stop_ = false;
+};
+
+// One writer keeps publishing a fresh object, holding it briefly and then dropping the last
+// strong reference, while the measured threads lock weak references to whatever was published
+// last. Readers refresh their weak reference every kRefreshEvery locks, so they see both live
+// and expired objects; the hit rate reports the split.
+template <typename Strong, typename Weak, typename Make, typename Lock>
+void RegisterContendedLock(const char* implementation, Make make, Lock lock) {
+    static constexpr size_t kRefreshEvery = 64;
+    static constexpr size_t kHoldSpins = 256;
+    static std::mutex mutex;
+    static Weak published;
+    static BackgroundWriters writer;
+    static std::atomic<size_t> hits = 0;
+    static std::atomic<size_t> attempts = 0;
+    Case c{"weak_lock_contended", implementation,
+           [lock](size_t n, size_t) {
+               Weak weak;
+               size_t local_hits = 0;
+               for (size_t i = 0; i < n; ++i) {
+                   if (i % kRefreshEvery == 0) {
+                       std::lock_guard guard(mutex);
+                       weak = published;
+                   }
+                   auto locked = lock(weak);
+                   local_hits += static_cast<bool>(locked);
+                   DoNotOptimize(locked);
+               }
+               hits.fetch_add(local_hits);
+               attempts.fetch_add(n);
+           },
+           [make](size_t) {
+               hits = 0;
+               attempts = 0;
+               writer.Start(1, [make](size_t round) {
+                   Strong owner = make(int(round));
+                   {
+                       std::lock_guard guard(mutex);
+                       published = owner;
+                   }
+                   for (size_t spin = 0; spin < kHoldSpins; ++spin) {
+                       DoNotOptimize(spin);
+                   }
+                   owner = nullptr;
+                   for (size_t spin = 0; spin < kHoldSpins; ++spin) {
+                       DoNotOptimize(spin);
+                   }
+               });
+           },
+           [] {
+               writer.Stop();
+               published = Weak();
+           }};
+    c.hit_rate = [] { return double(hits.load()) / double(attempts.load()); };
+    Register(std::move(c));
+}
+
+void RegisterWeak() {
+    static SharedPtr<Payload, MultiThreaded> shared;
+    static std::shared_ptr<Payload> std_shared;
+    Register({"weak_lock", "WeakPtr::Lock",
+              [](size_t n, size_t) {
+                  WeakPtr<Payload, MultiThreaded> weak(shared);
+                  for (size_t i = 0; i < n; ++i) {
+                      auto locked = weak.Lock();
+                      DoNotOptimize(locked);
+                  }
+              },
+              [](size_t) { shared = MakeShared<Payload, MultiThreaded>(1); },
+              [] { shared.Reset(); }});
+    Register({"weak_lock", "std::weak_ptr::lock",
+              [](size_t n, size_t) {
+                  std::weak_ptr<Payload> weak(std_shared);
+                  for (size_t i = 0; i < n; ++i) {
+                      auto locked = weak.lock();
+                      DoNotOptimize(locked);
+                  }
+              },
+              [](size_t) { std_shared = std::make_shared<Payload>(1); },
+              [] { std_shared.reset(); }});
+
+    Register({"weak_lock_miss", "WeakPtr::Lock", [](size_t n, size_t) {
+                  WeakPtr<Payload, MultiThreaded> weak(MakeShared<Payload, MultiThreaded>(1));
+                  for (size_t i = 0; i < n; ++i) {
+                      auto locked = weak.Lock();
+                      DoNotOptimize(locked);
+                  }
+              }});
+    Register({"weak_lock_miss", "std::weak_ptr::lock", [](size_t n, size_t) {
+                  std::weak_ptr<Payload> weak(std::make_shared<Payload>(1));
+                  for (size_t i = 0; i < n; ++i) {
+                      auto locked = weak.lock();
+                      DoNotOptimize(locked);
+                  }
+              }});
+
+    RegisterContendedLock<SharedPtr<Payload, MultiThreaded>, WeakPtr<Payload, MultiThreaded>>(
+        "WeakPtr::Lock", [](int v) { return MakeShared<Payload, MultiThreaded>(v); },
+        [](const WeakPtr<Payload, MultiThreaded>& weak) { return weak.Lock(); });
+    RegisterContendedLock<std::shared_ptr<Payload>, std::weak_ptr<Payload>>(
+        "std::weak_ptr::lock", [](int v) { return std::make_shared<Payload>(v); },
+        [](const std::weak_ptr<Payload>& weak) { return weak.lock(); });
+}
+
+// --- Concurrent readers of a published value ---------------------------------------------
+
+void RegisterPublished() {
+    static AtomicSharedPtr<Payload>* atomic_shared = nullptr;
+    static std::shared_ptr<Payload> std_published;
+    static HazardSlot<HazardPayload>* hazard_slot = nullptr;
+    static EpochSlot<Payload>* epoch_slot = nullptr;
+
+    Register({"published_read", "AtomicSharedPtr::Load",
+              [](size_t n, size_t) {
+                  for (size_t i = 0; i < n; ++i) {
+                      auto value = atomic_shared->Load();
+                      DoNotOptimize(value->value);
+                  }
+              },
+              [](size_t) {
+                  auto value = MakeShared<Payload, MultiThreaded>(1);
+                  atomic_shared = new AtomicSharedPtr<Payload>(value);
+              },
+              [] { delete std::exchange(atomic_shared, nullptr); },
+              true});
+    Register({"published_read", "std::atomic_load(shared_ptr)",
+              [](size_t n, size_t) {
+                  for (size_t i = 0; i < n; ++i) {
+                      auto value = std::atomic_load(&std_published);
+                      DoNotOptimize(value->value);
+                  }
+              },
+              [](size_t) { std_published = std::make_shared<Payload>(1); },
+              [] { std_published.reset(); },
+              true});
+    Register({"published_read", "HazardSlot::Protect",
+              [](size_t n, size_t) {
+                  HazardPointer hazard;
+                  for (size_t i = 0; i < n; ++i) {
+                      DoNotOptimize(hazard_slot->Protect(hazard)->value);
+                      hazard.Reset();
+                  }
+              },
+              [](size_t) {
+                  hazard_slot = new HazardSlot<HazardPayload>(MakeIntrusive<HazardPayload>(1));
+              },
+              [] { delete std::exchange(hazard_slot, nullptr); },
+              true});
+    Register({"published_read", "EpochSlot::Borrow",
+              [](size_t n, size_t) {
+                  for (size_t i = 0; i < n; ++i) {
+                      EpochGuard guard;
+                      DoNotOptimize(epoch_slot->Borrow(guard)->value);
+                  }
+              },
+              [](size_t) { epoch_slot = new EpochSlot<Payload>(MakeEpochShared<Payload>(1)); },
+              [] { delete std::exchange(epoch_slot, nullptr); },
+              true});
+}
+
+// Readers run on the measured threads while background writers keep replacing the value, so
+// the split count is handed back to retired nodes and CAS loops retry under contention.
+void RegisterPublishedWithWriters() {
+    static AtomicSharedPtr<Payload>* atomic_shared = nullptr;
+    static std::shared_ptr<Payload> std_published;
+    static BackgroundWriters writers;
+
+    for (size_t count : {1, 2, 4}) {
+        std::string suffix = "+" + std::to_string(count) + "w";
+        Register({"published_read_vs_writers", "AtomicSharedPtr::Load" + suffix,
+                  [](size_t n, size_t) {
+                      for (size_t i = 0; i < n; ++i) {
+                          auto value = atomic_shared->Load();
+                          DoNotOptimize(value->value);
+                      }
+                  },
+                  [count](size_t) {
+                      atomic_shared =
+                          new AtomicSharedPtr<Payload>(MakeShared<Payload, MultiThreaded>(0));
+                      writers.Start(count, [](size_t round) {
+                          auto fresh = MakeShared<Payload, MultiThreaded>(int(round));
+                          if (round % 3 == 0) {
+                              atomic_shared->Store(std::move(fresh));
+                          } else if (round % 3 == 1) {
+                              DoNotOptimize(atomic_shared->Exchange(std::move(fresh)).Get());
+                          } else {
+                              auto expected = atomic_shared->Load();
+                              atomic_shared->CompareExchange(expected, std::move(fresh));
+                          }
+                      });
+                  },
+                  [] {
+                      writers.Stop();
+                      delete std::exchange(atomic_shared, nullptr);
+                  },
+                  true});
+        Register({"published_read_vs_writers", "std::atomic_load(shared_ptr)" + suffix,
+                  [](size_t n, size_t) {
+                      for (size_t i = 0; i < n; ++i) {
+                          auto value = std::atomic_load(&std_published);
+                          DoNotOptimize(value->value);
+                      }
+                  },
+                  [count](size_t) {
+                      std_published = std::make_shared<Payload>(0);
+                      writers.Start(count, [](size_t round) {
+                          std::atomic_store(&std_published, std::make_shared<Payload>(int(round)));
+                      });
+                  },
+                  [] {
+                      writers.Stop();
+                      std_published.reset();
+                  },
+                  true});
+    }
+}
+
+// --- Relocation on growth, insertion and erase ------------------------------------------
+//
+// Growth pushes `iterations` copies of one pointer, so run it with --iterations 1000000 up to
+// 100000000 to cover caches through main memory. The copies cost the same for both
+// containers; what differs is moving the existing elements.
+
+template <typename Vector>
+void PushBackElement(Vector& vector, const typename Vector::value_type& value) {
+    vector.push_back(value);
+}
+
+template <typename T>
+void PushBackElement(RelocatingVector<T>& vector, const T& value) {
+    vector.PushBack(value);
+}
+
+template <typename Vector>
+void InsertMiddle(Vector& vector, const typename Vector::value_type& value) {
+    vector.insert(vector.begin() + vector.size() / 2, value);
+    vector.erase(vector.begin() + vector.size() / 2);
+}
+
+template <typename T>
+void InsertMiddle(RelocatingVector<T>& vector, const T& value) {
+    vector.Insert(vector.Size() / 2, value);
+    vector.Erase(vector.Size() / 2);
+}
+
+template <typename Vector, typename Make>
+void RegisterRelocation(const char* implementation, Make make) {
+    Register({"relocating_growth", implementation, [make](size_t n, size_t) {
+                  auto value = make(1);
+                  Vector vector;
+                  for (size_t i = 0; i < n; ++i) {
+                      PushBackElement(vector, value);
+                  }
+                  DoNotOptimize(vector.begin());
+              }});
+    Register({"insert_erase_middle", implementation, [make](size_t n, size_t) {
+                  auto value = make(1);
+                  Vector vector;
+                  for (size_t i = 0; i < kContainerSize; ++i) {
+                      PushBackElement(vector, value);
+                  }
+                  for (size_t i = 0; i < n; ++i) {
+                      InsertMiddle(vector, value);
+                  }
+                  DoNotOptimize(vector.begin());
+              }});
+}
+
+void RegisterRelocations() {
+    auto make_shared = [](int v) { return MakeShared<Payload>(v); };
+    RegisterRelocation<std::vector<SharedPtr<Payload>>>("std::vector<SharedPtr>", make_shared);
+    RegisterRelocation<RelocatingVector<SharedPtr<Payload>>>("RelocatingVector<SharedPtr>",
+                                                             make_shared);
+    auto make_intrusive = [](int v) { return MakeIntrusive<IntrusivePayload>(v); };
+    RegisterRelocation<std::vector<IntrusivePtr<IntrusivePayload>>>("std::vector<IntrusivePtr>",
+                                                                    make_intrusive);
+    RegisterRelocation<RelocatingVector<IntrusivePtr<IntrusivePayload>>>(
+        "RelocatingVector<IntrusivePtr>", make_intrusive);
+}
+
+// --- Random reads over a large table ----------------------------------------------------
+
+template <typename Table>
+void RegisterTable(const char* implementation, size_t table_mib, Table (*make)(size_t)) {
+    static std::vector<Table> tables;
+    static size_t size = 0;
+    size = table_mib * (size_t(1) << 20) / sizeof(uint64_t);
+    Register({"table_random_read", implementation,
+              [](size_t n, size_t thread) {
+                  const uint64_t* table = tables.back().Get();
+                  uint64_t state = 0x9e3779b97f4a7c15ull * (thread + 1);
+                  uint64_t sum = 0;
+                  for (size_t i = 0; i < n; ++i) {
+                      state ^= state << 13;
+                      state ^= state >> 7;
+                      state ^= state << 17;
+                      sum += table[state % size];
+                  }
+                  DoNotOptimize(sum);
+              },
+              [make](size_t) {
+                  tables.push_back(make(size));
+                  uint64_t* table = tables.back().Get();
+                  for (size_t i = 0; i < size; ++i) {
+                      table[i] = i;
+                  }
+              },
+              [] { tables.clear(); }});
+}
+
+void RegisterTables(size_t table_mib) {
+    RegisterTable<UniquePtr<uint64_t[]>>("new[]", table_mib, [](size_t n) {
+        return MakeUniqueForOverwrite<uint64_t[]>(n);
+    });
+    using Mapped = UniquePtr<uint64_t[], MappedArrayDeleter<uint64_t>>;
+    RegisterTable<Mapped>("mmap", table_mib, [](size_t n) {
+        return MakeUniqueMapped<uint64_t[]>(n);
+    });
+    RegisterTable<Mapped>("mmap+populate", table_mib, [](size_t n) {
+        return MakeUniqueMapped<uint64_t[]>(n, {false, true});
+    });
+    RegisterTable<Mapped>("mmap+hugepages", table_mib, [](size_t n) {
+        return MakeUniqueMapped<uint64_t[]>(n, {true, true});
+    });
+}
+
+// --- Driver ------------------------------------------------------------------------------
+
+struct Result {
+    const Case* c;
+    size_t threads;
+    size_t iterations;
+    double ns_per_op;
+    double hit_rate;
+};
+
+Result Run(const Case& c, size_t threads, size_t iterations) {
+    c.setup(threads);
+    std::atomic<size_t> ready = 0;
+    std::atomic<bool> go = false;
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            c.run(iterations / 16 + 1, t);
+            ready.fetch_add(1);
+            while (!go.load()) {
+                std::this_thread::yield();
+            }
+            c.run(iterations, t);
+        });
+    }
+    while (ready.load() != threads) {
+        std::this_thread::yield();
+    }
+    auto start = std::chrono::steady_clock::now();
+    go.store(true);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    c.teardown();
+    double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+    double hit_rate = c.hit_rate ? c.hit_rate() : -1.0;
+    return {&c, threads, iterations, ns / iterations, hit_rate};
+}
+
+void PrintCsv(const std::vector<Result>& results) {
+    std::printf("benchmark,implementation,threads,iterations,ns_per_op,hit_rate\n");
+    for (const Result& r : results) {
+        std::printf("%s,%s,%zu,%zu,%.3f,", r.c->name.c_str(), r.c->implementation.c_str(),
+                    r.threads, r.iterations, r.ns_per_op);
+        if (r.hit_rate >= 0) {
+            std::printf("%.4f", r.hit_rate);
+        }
+        std::printf("\n");
+    }
+}
+
+void PrintJson(const std::vector<Result>& results) {
+    std::printf("[\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        std::printf("  {\"benchmark\": \"%s\", \"implementation\": \"%s\", \"threads\": %zu, "
+                    "\"iterations\": %zu, \"ns_per_op\": %.3f",
+                    r.c->name.c_str(), r.c->implementation.c_str(), r.threads, r.iterations,
+                    r.ns_per_op);
+        if (r.hit_rate >= 0) {
+            std::printf(", \"hit_rate\": %.4f", r.hit_rate);
+        }
+        std::printf("}%s\n", i + 1 == results.size() ? "" : ",");
+    }
+    std::printf("]\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::string format = "csv";
+    std::string filter;
+    size_t threads = std::max(2u, std::thread::hardware_concurrency());
+    size_t iterations = 1000000;
+    size_t table_mib = 1024;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--format") == 0) {
+            format = argv[i + 1];
+        } else if (std::strcmp(argv[i], "--threads") == 0) {
+            threads = std::strtoul(argv[i + 1], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--iterations") == 0) {
+            iterations = std::strtoul(argv[i + 1], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--table-mib") == 0) {
+            table_mib = std::strtoul(argv[i + 1], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--filter") == 0) {
+            filter = argv[i + 1];
+        } else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    RegisterConstruction();
+    RegisterCopies();
+    RegisterContainers();
+    RegisterChains();
+    RegisterWeak();
+    RegisterPublished();
+    RegisterPublishedWithWriters();
+    RegisterRelocations();
+    RegisterTables(table_mib);
+
+    std::vector<Result> results;
+    for (const Case& c : Registry()) {
+        std::string id = c.name + "/" + c.implementation;
+        if (!filter.empty() && id.find(filter) == std::string::npos) {
+            continue;
+        }
+        if (c.sweep_threads) {
+            for (size_t t = 1; t < threads; t *= 2) {
+                results.push_back(Run(c, t, iterations));
+            }
+            results.push_back(Run(c, threads, iterations));
+            continue;
+        }
+        results.push_back(Run(c, 1, iterations));
+        if (threads > 1) {
+            results.push_back(Run(c, threads, iterations));
+        }
+    }
+    if (format == "json") {
+        PrintJson(results);
+    } else {
+        PrintCsv(results);
+    }
+    return 0;
+}
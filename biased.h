@@ -0,0 +1,265 @@
+#pragma once
+
+#include "sw_fwd.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Biased reference counting: the thread that creates a block counts its own strong
+// references in a plain counter, every other thread uses an atomic one. The two are merged
+// when the owner drops its last biased reference. A non-owner that drives the shared
+// counter below zero queues the block to its owner, which merges it on its next strong
+// release, at DrainBiasedMerges() or at thread exit.
+struct Biased {
+    class Owner;
+
+    class Counters {
+    public:
+        Counters();
+
+        ~Counters();
+
+        size_t GetStrong() const {
+            int64_t shared = shared_.load(std::memory_order_acquire);
+            int64_t count = Count(shared);
+            if ((shared & kMerged) == 0) {
+                count += biased_.load(std::memory_order_relaxed);
+            }
+            return count > 0 ? count : 0;
+        }
+
+        size_t GetWeak() const {
+            return weak_.load(std::memory_order_acquire);
+        }
+
+        void IncStrong() {
+            if (IsBiasedOwner()) {
+                biased_.store(biased_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return;
+            }
+            shared_.fetch_add(kShareOne, std::memory_order_relaxed);
+        }
+
+        void IncWeak() {
+            weak_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Until the merge the count is split, and a block queued to its owner may already be
+        // at zero in total, so both halves decide.
+        bool TryIncStrong() {
+            int64_t shared = shared_.load(std::memory_order_acquire);
+            while ((shared & kMerged) == 0) {
+                if (Count(shared) + biased_.load(std::memory_order_relaxed) <= 0) {
+                    return false;
+                }
+                if (IsBiasedOwner()) {
+                    IncStrong();
+                    return true;
+                }
+                if (shared_.compare_exchange_weak(shared, shared + kShareOne,
+                                                  std::memory_order_acq_rel,
+                                                  std::memory_order_acquire)) {
+                    return true;
+                }
+            }
+            do {
+                if (Count(shared) == 0) {
+                    return false;
+                }
+            } while (!shared_.compare_exchange_weak(shared, shared + kShareOne,
+                                                    std::memory_order_acq_rel,
+                                                    std::memory_order_relaxed));
+            return true;
+        }
+
+        StrongRelease DecStrong();
+
+        bool DecWeak() {
+            return weak_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+        }
+
+    private:
+        friend class Owner;
+
+        static constexpr int64_t kMerged = 1;
+        static constexpr int64_t kQueued = 2;
+        static constexpr int64_t kShareOne = 4;
+
+        static int64_t Count(int64_t shared) {
+            return (shared & ~(kShareOne - 1)) / kShareOne;
+        }
+
+        bool IsBiasedOwner() const;
+
+        StrongRelease Merge();
+
+        StrongRelease Released(int64_t shared) const {
+            if (Count(shared) != 0) {
+                return StrongRelease::kAlive;
+            }
+            return weak_.load(std::memory_order_acquire) == 1 ? StrongRelease::kLastReference
+                                                              : StrongRelease::kLastStrong;
+        }
+
+        std::atomic<int64_t> shared_ = 0;
+        std::atomic<int64_t> biased_ = 0;
+        std::atomic<size_t> weak_ = 1;
+        Owner* owner_;
+    };
+
+    class Owner {
+    public:
+        // Null once the thread's handle is destroyed; blocks created after that start merged.
+        static Owner* Current() {
+            if (HandleDestroyed()) {
+                return nullptr;
+            }
+            static thread_local Handle handle;
+            return handle.owner;
+        }
+
+        void Ref() {
+            refs_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void Unref() {
+            if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                delete this;
+            }
+        }
+
+        bool HasPending() const {
+            return pending_.load(std::memory_order_relaxed);
+        }
+
+        void Enqueue(Counters* counters) {
+            {
+                std::lock_guard lock(mutex_);
+                if (alive_) {
+                    queue_.push_back(counters);
+                    pending_.store(true, std::memory_order_relaxed);
+                    return;
+                }
+            }
+            MergeAndRelease(counters);
+        }
+
+        void Drain() {
+            std::vector<Counters*> queue;
+            {
+                std::lock_guard lock(mutex_);
+                queue.swap(queue_);
+                pending_.store(false, std::memory_order_relaxed);
+            }
+            for (Counters* counters : queue) {
+                MergeAndRelease(counters);
+            }
+        }
+
+    private:
+        struct Handle {
+            Handle() : owner(new Owner) {
+            }
+
+            ~Handle() {
+                HandleDestroyed() = true;
+                {
+                    std::lock_guard lock(owner->mutex_);
+                    owner->alive_ = false;
+                }
+                owner->Drain();
+                owner->Unref();
+            }
+
+            Owner* owner;
+        };
+
+        // Trivially destructible, so it stays readable for the whole life of the thread.
+        static bool& HandleDestroyed() {
+            static thread_local bool destroyed = false;
+            return destroyed;
+        }
+
+        // A queued block is pinned by a weak reference, so it may already have been
+        // merged by its owner dropping the last biased reference.
+        static void MergeAndRelease(Counters* counters) {
+            auto block = ControlBlockBase<Biased>::FromCounters(counters);
+            if ((counters->shared_.load(std::memory_order_acquire) & Counters::kMerged) == 0) {
+                block->ReleaseStrong(counters->Merge());
+            }
+            block->DecWCounter();
+        }
+
+        std::atomic<size_t> refs_ = 1;
+        std::atomic<bool> pending_ = false;
+        std::mutex mutex_;
+        std::vector<Counters*> queue_;
+        bool alive_ = true;
+    };
+};
+
+inline Biased::Counters::Counters() : owner_(Owner::Current()) {
+    if (owner_ == nullptr) {
+        shared_.store(kMerged, std::memory_order_relaxed);
+    } else {
+        owner_->Ref();
+    }
+}
+
+inline Biased::Counters::~Counters() {
+    if (owner_ != nullptr) {
+        owner_->Unref();
+    }
+}
+
+inline bool Biased::Counters::IsBiasedOwner() const {
+    return (shared_.load(std::memory_order_relaxed) & kMerged) == 0 && owner_ == Owner::Current();
+}
+
+inline StrongRelease Biased::Counters::DecStrong() {
+    if (IsBiasedOwner() && owner_->HasPending()) {
+        owner_->Drain();
+    }
+    if (IsBiasedOwner()) {
+        int64_t biased = biased_.load(std::memory_order_relaxed) - 1;
+        biased_.store(biased, std::memory_order_relaxed);
+        return biased == 0 ? Merge() : StrongRelease::kAlive;
+    }
+    int64_t shared = shared_.load(std::memory_order_relaxed);
+    while ((shared & kMerged) != 0 || Count(shared) > 0) {
+        if (shared_.compare_exchange_weak(shared, shared - kShareOne, std::memory_order_acq_rel,
+                                          std::memory_order_relaxed)) {
+            return (shared & kMerged) != 0 ? Released(shared - kShareOne) : StrongRelease::kAlive;
+        }
+    }
+    // The shared count is about to go negative, so the owner may free the block as soon as
+    // it merges: pin it with a weak reference while we still hold a strong one.
+    IncWeak();
+    shared = shared_.fetch_sub(kShareOne, std::memory_order_acq_rel) - kShareOne;
+    if ((shared & kMerged) == 0 && Count(shared) < 0 &&
+        (shared_.fetch_or(kQueued, std::memory_order_acq_rel) & kQueued) == 0) {
+        owner_->Enqueue(this);
+        return StrongRelease::kAlive;
+    }
+    weak_.fetch_sub(1, std::memory_order_release);
+    return (shared & kMerged) != 0 ? Released(shared) : StrongRelease::kAlive;
+}
+
+// Runs on the owner thread, or on any thread once the owner has exited.
+inline StrongRelease Biased::Counters::Merge() {
+    int64_t biased = biased_.exchange(0, std::memory_order_relaxed);
+    int64_t shared =
+        shared_.fetch_add(biased * kShareOne + kMerged, std::memory_order_acq_rel) +
+        biased * kShareOne + kMerged;
+    return Released(shared);
+}
+
+inline void DrainBiasedMerges() {
+    if (Biased::Owner* owner = Biased::Owner::Current()) {
+        owner->Drain();
+    }
+}
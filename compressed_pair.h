@@ -15,6 +15,10 @@ public:
     CompressedPair() : first_(T1()), second_(T2()) {
     }
 
+    // Leaves the second element default-initialized, so raw storage is not zero-filled.
+    explicit CompressedPair(const T1& first) : first_(first) {
+    }
+
     template <typename U1, typename U2>
     CompressedPair(U1&& first, U2&& second)
         : first_(std::forward<U1>(first)), second_(std::forward<U2>(second)) {
@@ -50,6 +54,9 @@ public:
     CompressedPair() : first_(T1()) {
     }
 
+    explicit CompressedPair(const T1& first) : first_(first) {
+    }
+
     template <typename U1, typename U2>
     CompressedPair(U1&& first, U2&& second)
         : first_(std::forward<U1>(first)), T2(std::forward<U2>(second)) {
@@ -84,6 +91,9 @@ public:
     CompressedPair() : second_(T2()) {
     }
 
+    explicit CompressedPair(const T1& first) : T1(first) {
+    }
+
     template <typename U1, typename U2>
     CompressedPair(U1&& first, U2&& second)
         : T1(std::forward<U1>(first)), second_(std::forward<U2>(second)) {
@@ -117,6 +127,9 @@ class CompressedPair<T1, T2, 1, 1, 0> : T1, T2 {
 public:
     CompressedPair() = default;
 
+    explicit CompressedPair(const T1& first) : T1(first) {
+    }
+
     template <typename U1, typename U2>
     CompressedPair(U1&& first, U2&& second)
         : T1(std::forward<U1>(first)), T2(std::forward<U2>(second)) {
@@ -144,6 +157,9 @@ class CompressedPair<T1, T2, 1, 1, 1> : T1 {
 public:
     CompressedPair() = default;
 
+    explicit CompressedPair(const T1& first) : first_(first) {
+    }
+
     template <typename U1, typename U2>
     CompressedPair(U1&& first, U2&& second)
         : first_(std::forward<U1>(first)), T2(std::forward<U2>(second)) {
@@ -0,0 +1,449 @@
+#pragma once
+
+#include "shared.h"
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Passed to T::TraceEdges(CycleEdgeVisitor&), which must call it once for every SharedPtr
+// the object owns. The collector uses it both to count references and to break cycles.
+class CycleEdgeVisitor {
+public:
+    using Callback = void (*)(void* context, ControlBlockBase<>* target);
+
+    template <typename U>
+    void operator()(SharedPtr<U>& edge) {
+        if (edge.block_ == nullptr) {
+            return;
+        }
+        if (callback_ == nullptr) {
+            edge.Reset();
+        } else {
+            callback_(context_, edge.block_);
+        }
+    }
+
+private:
+    friend class CycleCollector;
+
+    CycleEdgeVisitor(Callback callback, void* context) : callback_(callback), context_(context) {
+    }
+
+    Callback callback_;
+    void* context_;
+};
+
+struct CycleCollectorStats {
+    size_t collections = 0;
+    size_t reclaimed_objects = 0;
+    size_t reclaimed_bytes = 0;
+};
+
+class CycleCollector;
+
+// Base of every block made by MakeCollectable. They all share one destroy function, so the
+// collector recognises a tracked block behind any edge, and the block tells its collector
+// when the object dies.
+class ControlBlockCollectable : public ControlBlockBase<> {
+public:
+    using Tracer = void (*)(ControlBlockCollectable* block, CycleEdgeVisitor& visitor);
+
+    static ControlBlockCollectable* FromBase(ControlBlockBase<>* base) {
+        if (base == nullptr || base->GetDestroyer() != &Destroy) {
+            return nullptr;
+        }
+        return static_cast<ControlBlockCollectable*>(base);
+    }
+
+protected:
+    using Disposer = void (*)(ControlBlockCollectable* block, BlockDestroy what);
+
+    ControlBlockCollectable(Disposer dispose, Tracer trace, size_t bytes)
+        : ControlBlockBase<>(&Destroy), dispose_(dispose), trace_(trace), bytes_(bytes) {
+    }
+
+    ~ControlBlockCollectable() = default;
+
+private:
+    friend class CycleCollector;
+
+    static void Destroy(ControlBlockBase<>* base, BlockDestroy what);
+
+    Disposer dispose_;
+    Tracer trace_;
+    size_t bytes_;
+    CycleCollector* collector_ = nullptr;
+    size_t slot_ = 0;
+};
+
+template <typename T>
+class ControlBlockCollectableHolder : public ControlBlockCollectable {
+public:
+    template <typename... Args>
+    ControlBlockCollectableHolder(Args&&... args)
+        : ControlBlockCollectable(&Dispose, &Trace, sizeof(ControlBlockCollectableHolder)) {
+        new (&storage_) T(std::forward<Args>(args)...);
+        SMART_POINTERS_INSTRUMENT(this->Track(Instrumentation::For<T>());)
+    }
+
+    T* GetPointer() {
+        return reinterpret_cast<T*>(&storage_);
+    }
+
+private:
+    static void Dispose(ControlBlockCollectable* base, BlockDestroy what) {
+        auto self = static_cast<ControlBlockCollectableHolder*>(base);
+        if (what != BlockDestroy::kBlock) {
+            self->GetPointer()->~T();
+            SMART_POINTERS_INSTRUMENT(Instrumentation::Destroyed(self->Stats());)
+        }
+        if (what != BlockDestroy::kObject) {
+            SMART_POINTERS_INSTRUMENT(Instrumentation::Deallocated(self->Stats());)
+            delete self;
+        }
+    }
+
+    static void Trace(ControlBlockCollectable* base, CycleEdgeVisitor& visitor) {
+        static_cast<ControlBlockCollectableHolder*>(base)->GetPointer()->TraceEdges(visitor);
+    }
+
+    std::aligned_storage_t<sizeof(T), alignof(T)> storage_;
+};
+
+// Trial deletion over every object created by MakeCollectable. Objects whose strong count
+// is fully explained by edges from other tracked objects, and that no externally referenced
+// object reaches, are garbage; the collector breaks their edges and lets them die.
+//
+// Every phase is spread over Step() calls while the graph keeps changing, so counting and
+// marking only nominate candidates. Release then takes one candidate at a time, gathers
+// what it reaches among the unmarked, and verifies and frees that set within a single step,
+// where the graph cannot change. A step may overrun its budget by the cost of one such set,
+// and garbage reachable only from other garbage may wait for the next collection. An object
+// that dies leaves the collector right away, so its block is freed as usual. Single-threaded
+// SharedPtr only.
+class CycleCollector {
+public:
+    static CycleCollector& Global() {
+        static CycleCollector collector;
+        return collector;
+    }
+
+    CycleCollector() = default;
+
+    CycleCollector(const CycleCollector&) = delete;
+    CycleCollector& operator=(const CycleCollector&) = delete;
+
+    ~CycleCollector() {
+        for (const Entry& entry : entries_) {
+            if (entry.block != nullptr) {
+                entry.block->collector_ = nullptr;
+            }
+        }
+    }
+
+    // Objects tracked during a collection wait for the next one.
+    void Track(ControlBlockCollectable* block) {
+        if (phase_ == Phase::kIdle && entries_.size() >= 2 * tracked_ + kCompactSlack) {
+            Compact();
+        }
+        entries_.push_back({block});
+        block->collector_ = this;
+        block->slot_ = entries_.size() - 1;
+        ++tracked_;
+    }
+
+    // Runs the current collection for roughly `budget`; returns true when it completed.
+    bool Step(std::chrono::nanoseconds budget) {
+        return Advance(std::chrono::steady_clock::now() + budget);
+    }
+
+    CycleCollectorStats Collect() {
+        while (!Advance(std::chrono::steady_clock::time_point::max())) {
+        }
+        return stats_;
+    }
+
+    const CycleCollectorStats& Stats() const {
+        return stats_;
+    }
+
+    size_t TrackedCount() const {
+        return tracked_;
+    }
+
+private:
+    friend class ControlBlockCollectable;
+
+    static constexpr size_t kWorkPerClockCheck = 64;
+    static constexpr size_t kCompactSlack = 1024;
+
+    enum class Phase { kIdle, kCompact, kCount, kMark, kRelease };
+
+    struct Entry {
+        ControlBlockCollectable* block;
+        size_t internal = 0;
+        bool marked = false;
+        bool joined = false;
+    };
+
+    bool Advance(std::chrono::steady_clock::time_point deadline) {
+        size_t work = 0;
+        size_t next_check = kWorkPerClockCheck;
+        auto out_of_time = [&] {
+            if (work < next_check) {
+                return false;
+            }
+            next_check = work + kWorkPerClockCheck;
+            return std::chrono::steady_clock::now() >= deadline;
+        };
+        while (true) {
+            switch (phase_) {
+                case Phase::kIdle:
+                    Start();
+                    break;
+                case Phase::kCompact:
+                    for (; cursor_ < entries_.size(); ++cursor_, ++work) {
+                        if (out_of_time()) {
+                            return false;
+                        }
+                        Keep(entries_[cursor_].block);
+                    }
+                    entries_.resize(kept_);
+                    limit_ = kept_;
+                    NextPhase(Phase::kCount);
+                    break;
+                case Phase::kCount:
+                    for (; cursor_ < limit_; ++cursor_, ++work) {
+                        if (out_of_time()) {
+                            return false;
+                        }
+                        TraceEntry(cursor_, &CountEdge);
+                    }
+                    NextPhase(Phase::kMark);
+                    break;
+                case Phase::kMark:
+                    for (; cursor_ < limit_ || !stack_.empty(); ++work) {
+                        if (out_of_time()) {
+                            return false;
+                        }
+                        if (!stack_.empty()) {
+                            size_t index = stack_.back();
+                            stack_.pop_back();
+                            TraceEntry(index, &MarkEdge);
+                        } else {
+                            Entry& entry = entries_[cursor_];
+                            if (Alive(cursor_) && entry.block->GetSCounter() > entry.internal) {
+                                Mark(cursor_);
+                            }
+                            ++cursor_;
+                        }
+                    }
+                    NextPhase(Phase::kRelease);
+                    break;
+                case Phase::kRelease:
+                    for (; cursor_ < limit_; ++cursor_, ++work) {
+                        if (out_of_time()) {
+                            return false;
+                        }
+                        if (!entries_[cursor_].marked && Alive(cursor_)) {
+                            work += ReleaseFrom(cursor_);
+                        }
+                    }
+                    ++stats_.collections;
+                    phase_ = Phase::kIdle;
+                    return true;
+            }
+        }
+    }
+
+    void Start() {
+        kept_ = 0;
+        NextPhase(Phase::kCompact);
+    }
+
+    // Without collections, entries of dead objects would pile up; this keeps them to about
+    // as many as there are live ones.
+    void Compact() {
+        kept_ = 0;
+        for (const Entry& entry : entries_) {
+            Keep(entry.block);
+        }
+        entries_.resize(kept_);
+    }
+
+    void NextPhase(Phase phase) {
+        phase_ = phase;
+        cursor_ = 0;
+    }
+
+    // Moves a live entry into the next compacted slot and clears its collection state.
+    void Keep(ControlBlockCollectable* block) {
+        if (block == nullptr) {
+            return;
+        }
+        entries_[kept_] = {block};
+        block->slot_ = kept_++;
+    }
+
+    void Forget(ControlBlockCollectable* block) {
+        entries_[block->slot_].block = nullptr;
+        --tracked_;
+    }
+
+    bool Alive(size_t index) const {
+        return entries_[index].block != nullptr;
+    }
+
+    void TraceEntry(size_t index, CycleEdgeVisitor::Callback callback) {
+        if (!Alive(index)) {
+            return;
+        }
+        CycleEdgeVisitor visitor(callback, this);
+        ControlBlockCollectable* block = entries_[index].block;
+        block->trace_(block, visitor);
+    }
+
+    Entry* Find(ControlBlockBase<>* target) {
+        ControlBlockCollectable* block = ControlBlockCollectable::FromBase(target);
+        if (block == nullptr || block->collector_ != this) {
+            return nullptr;
+        }
+        return &entries_[block->slot_];
+    }
+
+    static void CountEdge(void* context, ControlBlockBase<>* target) {
+        auto self = static_cast<CycleCollector*>(context);
+        if (Entry* entry = self->Find(target)) {
+            ++entry->internal;
+        }
+    }
+
+    static void MarkEdge(void* context, ControlBlockBase<>* target) {
+        auto self = static_cast<CycleCollector*>(context);
+        if (Entry* entry = self->Find(target)) {
+            self->Mark(entry->block->slot_);
+        }
+    }
+
+    void Mark(size_t index) {
+        if (!entries_[index].marked) {
+            entries_[index].marked = true;
+            stack_.push_back(index);
+        }
+    }
+
+    static void JoinEdge(void* context, ControlBlockBase<>* target) {
+        auto self = static_cast<CycleCollector*>(context);
+        if (Entry* entry = self->Find(target)) {
+            self->Join(entry->block->slot_);
+        }
+    }
+
+    void Join(size_t index) {
+        if (!entries_[index].marked && !entries_[index].joined) {
+            entries_[index].joined = true;
+            candidates_.push_back(index);
+        }
+    }
+
+    // Gathers everything `root` reaches among the unmarked and recounts that set among
+    // itself; any member with a reference from outside is marked together with everything
+    // it reaches, until the set is closed. Returns the work done.
+    size_t ReleaseFrom(size_t root) {
+        candidates_.clear();
+        Join(root);
+        for (size_t i = 0; i < candidates_.size(); ++i) {
+            TraceEntry(candidates_[i], &JoinEdge);
+        }
+        for (size_t i : candidates_) {
+            entries_[i].joined = false;
+        }
+        size_t work = candidates_.size();
+        bool closed = false;
+        while (!closed && !candidates_.empty()) {
+            for (size_t i : candidates_) {
+                entries_[i].internal = 0;
+            }
+            for (size_t i : candidates_) {
+                TraceEntry(i, &CountCandidateEdge);
+            }
+            closed = true;
+            for (size_t i : candidates_) {
+                if (entries_[i].block->GetSCounter() > entries_[i].internal) {
+                    Mark(i);
+                    closed = false;
+                }
+            }
+            while (!stack_.empty()) {
+                size_t index = stack_.back();
+                stack_.pop_back();
+                TraceEntry(index, &MarkEdge);
+                ++work;
+            }
+            size_t kept = 0;
+            for (size_t i : candidates_) {
+                if (!entries_[i].marked) {
+                    candidates_[kept++] = i;
+                }
+            }
+            candidates_.resize(kept);
+            work += kept;
+        }
+
+        // Hold every candidate while its edges are cut so that none dies mid-trace.
+        for (size_t i : candidates_) {
+            entries_[i].block->IncSCounter();
+        }
+        for (size_t i : candidates_) {
+            CycleEdgeVisitor breaker(nullptr, nullptr);
+            entries_[i].block->trace_(entries_[i].block, breaker);
+        }
+        for (size_t i : candidates_) {
+            stats_.reclaimed_bytes += entries_[i].block->bytes_;
+            entries_[i].block->DecSCounter();
+        }
+        stats_.reclaimed_objects += candidates_.size();
+        return work;
+    }
+
+    static void CountCandidateEdge(void* context, ControlBlockBase<>* target) {
+        auto self = static_cast<CycleCollector*>(context);
+        Entry* entry = self->Find(target);
+        if (entry != nullptr && !entry->marked) {
+            ++entry->internal;
+        }
+    }
+
+    // A deque, so admitting objects never moves the entries already there.
+    std::deque<Entry> entries_;
+    std::vector<size_t> stack_;
+    std::vector<size_t> candidates_;
+    Phase phase_ = Phase::kIdle;
+    size_t cursor_ = 0;
+    size_t kept_ = 0;
+    size_t limit_ = 0;
+    size_t tracked_ = 0;
+    CycleCollectorStats stats_;
+};
+
+inline void ControlBlockCollectable::Destroy(ControlBlockBase<>* base, BlockDestroy what) {
+    auto self = static_cast<ControlBlockCollectable*>(base);
+    if (what != BlockDestroy::kBlock && self->collector_ != nullptr) {
+        self->collector_->Forget(self);
+        self->collector_ = nullptr;
+    }
+    self->dispose_(self, what);
+}
+
+template <typename T, typename... Args>
+SharedPtr<T> MakeCollectable(Args&&... args) {
+    auto block = new ControlBlockCollectableHolder<T>(std::forward<Args>(args)...);
+    SharedPtr<T> result(block);
+    CycleCollector::Global().Track(block);
+    return result;
+}
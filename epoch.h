@@ -0,0 +1,342 @@
+#pragma once
+
+#include "shared.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Epoch-based reclamation: a reader announces the global epoch while it is inside an
+// EpochGuard, and an object retired in epoch e is reclaimed once the global epoch reaches
+// e + 2, which can only happen after every reader that could have seen it has left.
+//
+// The domain is never destroyed, so objects released by static destructors still find it.
+// Once a thread's participant is gone, its retired objects go straight to the orphans and a
+// late reader holds its record only until it leaves.
+class EpochDomain {
+public:
+    using Reclaimer = void (*)(void*);
+
+    static EpochDomain& Global() {
+        static auto domain = new EpochDomain;
+        return *domain;
+    }
+
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    // The fence orders the announcement before the reads of published pointers; Retire has
+    // the matching one, so a reader and a retiring writer cannot both miss each other.
+    void Enter() {
+        Reader& reader = LocalReader();
+        if (reader.depth++ == 0) {
+            if (reader.record == nullptr) {
+                reader.record = Acquire();
+                LocalParticipant();
+            }
+            reader.record->epoch.store(epoch_.load(std::memory_order_seq_cst),
+                                       std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    void Exit() {
+        Reader& reader = LocalReader();
+        if (--reader.depth == 0) {
+            reader.record->epoch.store(kQuiescent, std::memory_order_release);
+            if (reader.exited) {
+                reader.record->active.store(false, std::memory_order_release);
+                reader.record = nullptr;
+            }
+        }
+    }
+
+    // Collects once enough objects are waiting or the last collection is old enough, so a
+    // thread that retires a few large objects does not keep them until it exits.
+    void Retire(void* object, Reclaimer reclaim) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        Retired retired{object, reclaim, epoch_.load(std::memory_order_seq_cst)};
+        Participant* participant = LocalParticipant();
+        if (participant == nullptr) {
+            {
+                std::lock_guard lock(orphans_mutex_);
+                orphans_.push_back(retired);
+            }
+            Collect();
+            return;
+        }
+        participant->limbo.push_back(retired);
+        if (participant->limbo.size() >= kCollectThreshold ||
+            std::chrono::steady_clock::now() - participant->last_collect >= kCollectInterval) {
+            Collect();
+        }
+    }
+
+    // Advances the global epoch as far as active readers allow (two steps are all a retired
+    // object needs) and reclaims whatever this thread retired at least two epochs ago. A
+    // thread without a participant works on the orphans alone and hands back the rest.
+    void Collect() {
+        Participant* participant = LocalParticipant();
+        std::vector<Retired> orphaned;
+        std::vector<Retired>& limbo = participant != nullptr ? participant->limbo : orphaned;
+        {
+            std::lock_guard lock(orphans_mutex_);
+            limbo.insert(limbo.end(), orphans_.begin(), orphans_.end());
+            orphans_.clear();
+        }
+        if (participant != nullptr) {
+            participant->last_collect = std::chrono::steady_clock::now();
+        }
+        TryAdvance();
+        uint64_t epoch = TryAdvance();
+        std::vector<Retired> reclaimable;
+        for (size_t i = 0; i < limbo.size();) {
+            if (limbo[i].epoch + 2 <= epoch) {
+                reclaimable.push_back(limbo[i]);
+                limbo[i] = limbo.back();
+                limbo.pop_back();
+            } else {
+                ++i;
+            }
+        }
+        if (participant == nullptr && !orphaned.empty()) {
+            std::lock_guard lock(orphans_mutex_);
+            orphans_.insert(orphans_.end(), orphaned.begin(), orphaned.end());
+        }
+        for (const Retired& retired : reclaimable) {
+            retired.reclaim(retired.object);
+        }
+    }
+
+private:
+    static constexpr uint64_t kQuiescent = 0;
+    static constexpr size_t kCollectThreshold = 64;
+    static constexpr std::chrono::milliseconds kCollectInterval{10};
+
+    struct Record {
+        std::atomic<uint64_t> epoch = kQuiescent;
+        std::atomic<bool> active = false;
+        Record* next = nullptr;
+    };
+
+    struct Retired {
+        void* object;
+        Reclaimer reclaim;
+        uint64_t epoch;
+    };
+
+    // Trivially destructible, so it stays readable for the whole life of the thread.
+    struct Reader {
+        Record* record = nullptr;
+        size_t depth = 0;
+        bool exited = false;
+    };
+
+    struct Participant {
+        ~Participant() {
+            EpochDomain& domain = Global();
+            {
+                std::lock_guard lock(domain.orphans_mutex_);
+                domain.orphans_.insert(domain.orphans_.end(), limbo.begin(), limbo.end());
+            }
+            limbo.clear();
+            Reader& reader = LocalReader();
+            reader.exited = true;
+            domain.Collect();
+            if (reader.record != nullptr && reader.depth == 0) {
+                reader.record->active.store(false, std::memory_order_release);
+                reader.record = nullptr;
+            }
+        }
+
+        std::vector<Retired> limbo;
+        std::chrono::steady_clock::time_point last_collect;
+    };
+
+    EpochDomain() = default;
+
+    static Reader& LocalReader() {
+        static thread_local Reader reader;
+        return reader;
+    }
+
+    static Participant* LocalParticipant() {
+        if (LocalReader().exited) {
+            return nullptr;
+        }
+        static thread_local Participant participant;
+        return &participant;
+    }
+
+    Record* Acquire() {
+        for (Record* record = head_.load(std::memory_order_acquire); record != nullptr;
+             record = record->next) {
+            bool expected = false;
+            if (!record->active.load(std::memory_order_relaxed) &&
+                record->active.compare_exchange_strong(expected, true,
+                                                       std::memory_order_acquire)) {
+                return record;
+            }
+        }
+        Record* record = new Record;
+        record->active.store(true, std::memory_order_relaxed);
+        record->next = head_.load(std::memory_order_relaxed);
+        while (!head_.compare_exchange_weak(record->next, record, std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+        }
+        return record;
+    }
+
+    uint64_t TryAdvance() {
+        uint64_t epoch = epoch_.load(std::memory_order_seq_cst);
+        for (Record* record = head_.load(std::memory_order_acquire); record != nullptr;
+             record = record->next) {
+            uint64_t announced = record->epoch.load(std::memory_order_seq_cst);
+            if (announced != kQuiescent && announced != epoch) {
+                return epoch;
+            }
+        }
+        if (epoch_.compare_exchange_strong(epoch, epoch + 1, std::memory_order_seq_cst)) {
+            return epoch + 1;
+        }
+        return epoch;
+    }
+
+    std::atomic<uint64_t> epoch_ = 1;
+    std::atomic<Record*> head_ = nullptr;
+    std::mutex orphans_mutex_;
+    std::vector<Retired> orphans_;
+};
+
+class EpochGuard {
+public:
+    EpochGuard() {
+        EpochDomain::Global().Enter();
+    }
+
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+
+    ~EpochGuard() {
+        EpochDomain::Global().Exit();
+    }
+};
+
+// Like ControlBlockHolder, but the object is destroyed through the epoch domain. If weak
+// references remain, the block is pinned with one more until the object is gone.
+template <typename T, typename Policy>
+class ControlBlockEpochHolder : public ControlBlockBase<Policy> {
+public:
+    template <typename... Args>
+    ControlBlockEpochHolder(Args&&... args) : ControlBlockBase<Policy>(&Destroy) {
+        new (&storage_) T(std::forward<Args>(args)...);
+        SMART_POINTERS_INSTRUMENT(this->Track(Instrumentation::For<T>());)
+    }
+
+    T* GetPointer() {
+        return reinterpret_cast<T*>(&storage_);
+    }
+
+    // Recognises the block by its destroy function; returns null for any other kind.
+    static ControlBlockEpochHolder* FromBase(ControlBlockBase<Policy>* base) {
+        if (base == nullptr || base->GetDestroyer() != &Destroy) {
+            return nullptr;
+        }
+        return static_cast<ControlBlockEpochHolder*>(base);
+    }
+
+private:
+    static void Destroy(ControlBlockBase<Policy>* base, BlockDestroy what) {
+        auto self = static_cast<ControlBlockEpochHolder*>(base);
+        switch (what) {
+            case BlockDestroy::kObject:
+                self->IncWCounter();
+                EpochDomain::Global().Retire(self, &ReclaimObject);
+                return;
+            case BlockDestroy::kObjectAndBlock:
+                EpochDomain::Global().Retire(self, &ReclaimObjectAndBlock);
+                return;
+            case BlockDestroy::kBlock:
+                SMART_POINTERS_INSTRUMENT(Instrumentation::Deallocated(self->Stats());)
+                delete self;
+                return;
+        }
+    }
+
+    static void ReclaimObject(void* ptr) {
+        auto self = static_cast<ControlBlockEpochHolder*>(ptr);
+        self->GetPointer()->~T();
+        SMART_POINTERS_INSTRUMENT(Instrumentation::Destroyed(self->Stats());)
+        self->DecWCounter();
+    }
+
+    static void ReclaimObjectAndBlock(void* ptr) {
+        auto self = static_cast<ControlBlockEpochHolder*>(ptr);
+        self->GetPointer()->~T();
+        SMART_POINTERS_INSTRUMENT(Instrumentation::Destroyed(self->Stats());)
+        SMART_POINTERS_INSTRUMENT(Instrumentation::Deallocated(self->Stats());)
+        delete self;
+    }
+
+    std::aligned_storage_t<sizeof(T), alignof(T)> storage_;
+};
+
+template <typename T, typename Policy = MultiThreaded, typename... Args>
+SharedPtr<T, Policy> MakeEpochShared(Args&&... args) {
+    return SharedPtr<T, Policy>(
+        new ControlBlockEpochHolder<T, Policy>(std::forward<Args>(args)...));
+}
+
+class BadEpochPtr : public std::exception {};
+
+// A published SharedPtr that readers borrow inside an EpochGuard without touching its
+// counters. Only objects created by MakeEpochShared<T> may be stored: any other block would
+// free the object immediately under a borrowing reader, so Store throws BadEpochPtr for it.
+template <typename T, typename Policy = MultiThreaded>
+class EpochSlot {
+public:
+    EpochSlot() = default;
+
+    explicit EpochSlot(SharedPtr<T, Policy> value) {
+        Store(std::move(value));
+    }
+
+    EpochSlot(const EpochSlot&) = delete;
+    EpochSlot& operator=(const EpochSlot&) = delete;
+
+    void Store(SharedPtr<T, Policy> value) {
+        if (value.block_ != nullptr &&
+            ControlBlockEpochHolder<T, Policy>::FromBase(value.block_) == nullptr) {
+            throw BadEpochPtr();
+        }
+        {
+            std::lock_guard lock(mutex_);
+            ptr_.store(value.Get(), std::memory_order_release);
+            owner_.Swap(value);
+        }
+        // The superseded value is often a large snapshot; reclaim it now if no reader holds it.
+        value.Reset();
+        EpochDomain::Global().Collect();
+    }
+
+    SharedPtr<T, Policy> Load() const {
+        std::lock_guard lock(mutex_);
+        return owner_;
+    }
+
+    T* Borrow(const EpochGuard&) const {
+        return ptr_.load(std::memory_order_acquire);
+    }
+
+private:
+    std::atomic<T*> ptr_ = nullptr;
+    mutable std::mutex mutex_;
+    SharedPtr<T, Policy> owner_;
+};
@@ -0,0 +1,237 @@
+#pragma once
+
+#include "intrusive.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// Readers publish the address they are about to dereference in a hazard record; objects
+// whose last reference is dropped are retired instead of destroyed and reclaimed by a
+// later scan once no record holds their address. Scans run every time a thread's retire
+// list outgrows twice the number of records, so reclamation cost is amortised O(1).
+//
+// The domain is never destroyed, so objects released by static destructors still find it.
+class HazardDomain {
+public:
+    using Reclaimer = void (*)(void*);
+
+    static HazardDomain& Global() {
+        static auto domain = new HazardDomain;
+        return *domain;
+    }
+
+    HazardDomain(const HazardDomain&) = delete;
+    HazardDomain& operator=(const HazardDomain&) = delete;
+
+    void Retire(void* object, Reclaimer reclaim) {
+        RetireList* local = LocalRetired();
+        if (local == nullptr) {
+            {
+                std::lock_guard lock(orphans_mutex_);
+                orphans_.push_back({object, reclaim});
+            }
+            Scan();
+            return;
+        }
+        std::vector<Retired>& retired = local->list;
+        retired.push_back({object, reclaim});
+        if (retired.size() >= kMinScanThreshold &&
+            retired.size() >= 2 * records_.load(std::memory_order_relaxed)) {
+            Scan();
+        }
+    }
+
+    // A thread whose retire list is gone works on the orphans alone and hands back the rest.
+    void Scan() {
+        RetireList* local = LocalRetired();
+        std::vector<Retired> orphaned;
+        std::vector<Retired>& retired = local != nullptr ? local->list : orphaned;
+        {
+            std::lock_guard lock(orphans_mutex_);
+            retired.insert(retired.end(), orphans_.begin(), orphans_.end());
+            orphans_.clear();
+        }
+        std::vector<const void*> hazards;
+        for (Record* record = head_.load(std::memory_order_acquire); record != nullptr;
+             record = record->next) {
+            if (const void* hazard = record->hazard.load(std::memory_order_seq_cst)) {
+                hazards.push_back(hazard);
+            }
+        }
+        std::sort(hazards.begin(), hazards.end());
+        std::vector<Retired> reclaimable;
+        auto protected_end = std::partition(retired.begin(), retired.end(), [&](const Retired& r) {
+            return std::binary_search(hazards.begin(), hazards.end(), r.object);
+        });
+        reclaimable.assign(protected_end, retired.end());
+        retired.erase(protected_end, retired.end());
+        if (local == nullptr && !orphaned.empty()) {
+            std::lock_guard lock(orphans_mutex_);
+            orphans_.insert(orphans_.end(), orphaned.begin(), orphaned.end());
+        }
+        for (const Retired& r : reclaimable) {
+            r.reclaim(r.object);
+        }
+    }
+
+private:
+    friend class HazardPointer;
+
+    static constexpr size_t kMinScanThreshold = 64;
+
+    struct Record {
+        std::atomic<const void*> hazard = nullptr;
+        std::atomic<bool> active = false;
+        Record* next = nullptr;
+    };
+
+    struct Retired {
+        void* object;
+        Reclaimer reclaim;
+    };
+
+    struct RetireList {
+        ~RetireList() {
+            HazardDomain& domain = Global();
+            {
+                std::lock_guard lock(domain.orphans_mutex_);
+                domain.orphans_.insert(domain.orphans_.end(), list.begin(), list.end());
+            }
+            list.clear();
+            RetireListDestroyed() = true;
+            domain.Scan();
+        }
+
+        std::vector<Retired> list;
+    };
+
+    HazardDomain() = default;
+
+    // Trivially destructible, so it stays readable for the whole life of the thread.
+    static bool& RetireListDestroyed() {
+        static thread_local bool destroyed = false;
+        return destroyed;
+    }
+
+    static RetireList* LocalRetired() {
+        if (RetireListDestroyed()) {
+            return nullptr;
+        }
+        static thread_local RetireList retired;
+        return &retired;
+    }
+
+    Record* Acquire() {
+        for (Record* record = head_.load(std::memory_order_acquire); record != nullptr;
+             record = record->next) {
+            bool expected = false;
+            if (!record->active.load(std::memory_order_relaxed) &&
+                record->active.compare_exchange_strong(expected, true,
+                                                       std::memory_order_acquire)) {
+                return record;
+            }
+        }
+        Record* record = new Record;
+        record->active.store(true, std::memory_order_relaxed);
+        record->next = head_.load(std::memory_order_relaxed);
+        while (!head_.compare_exchange_weak(record->next, record, std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+        }
+        records_.fetch_add(1, std::memory_order_relaxed);
+        return record;
+    }
+
+    void Release(Record* record) {
+        record->hazard.store(nullptr, std::memory_order_release);
+        record->active.store(false, std::memory_order_release);
+    }
+
+    std::atomic<Record*> head_ = nullptr;
+    std::atomic<size_t> records_ = 0;
+    std::mutex orphans_mutex_;
+    std::vector<Retired> orphans_;
+};
+
+class HazardPointer {
+public:
+    HazardPointer() : record_(HazardDomain::Global().Acquire()) {
+    }
+
+    HazardPointer(const HazardPointer&) = delete;
+    HazardPointer& operator=(const HazardPointer&) = delete;
+
+    ~HazardPointer() {
+        HazardDomain::Global().Release(record_);
+    }
+
+    template <typename T>
+    T* Protect(const std::atomic<T*>& source) {
+        T* ptr = source.load(std::memory_order_relaxed);
+        while (true) {
+            record_->hazard.store(ptr, std::memory_order_seq_cst);
+            T* current = source.load(std::memory_order_seq_cst);
+            if (current == ptr) {
+                return ptr;
+            }
+            ptr = current;
+        }
+    }
+
+    void Reset() {
+        record_->hazard.store(nullptr, std::memory_order_release);
+    }
+
+private:
+    HazardDomain::Record* record_;
+};
+
+template <typename Deleter = DefaultDelete>
+struct HazardDelete {
+    template <typename T>
+    static void Destroy(T* object) {
+        HazardDomain::Global().Retire(object, [](void* ptr) {
+            Deleter::Destroy(static_cast<T*>(ptr));
+        });
+    }
+};
+
+// Owns one reference to the stored object. Readers take the raw pointer under a
+// HazardPointer and never touch the reference count; T must be destroyed through
+// HazardDelete for that to be safe.
+template <typename T>
+class HazardSlot {
+public:
+    HazardSlot() = default;
+
+    explicit HazardSlot(const IntrusivePtr<T>& value) {
+        Store(value);
+    }
+
+    HazardSlot(const HazardSlot&) = delete;
+    HazardSlot& operator=(const HazardSlot&) = delete;
+
+    ~HazardSlot() {
+        Store(nullptr);
+    }
+
+    void Store(const IntrusivePtr<T>& value) {
+        T* ptr = value.Get();
+        if (ptr != nullptr) {
+            ptr->IncRef();
+        }
+        T* old = ptr_.exchange(ptr, std::memory_order_acq_rel);
+        if (old != nullptr) {
+            old->DecRef();
+        }
+    }
+
+    T* Protect(HazardPointer& hazard) const {
+        return hazard.Protect(ptr_);
+    }
+
+private:
+    std::atomic<T*> ptr_ = nullptr;
+};
@@ -0,0 +1,190 @@
+#pragma once
+
+// Per-type counters of control block and RefCounted activity. Everything is compiled in
+// only with SMART_POINTERS_INSTRUMENTATION defined; otherwise the hooks expand to nothing.
+// Blocks keep their stats pointer either way, so the layout is the same in both builds, but
+// the inline hooks still differ: define the flag for the whole program or not at all.
+
+#ifdef SMART_POINTERS_INSTRUMENTATION
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
+
+#if defined(__GNUG__)
+#include <cxxabi.h>
+#endif
+
+#define SMART_POINTERS_INSTRUMENT(...) __VA_ARGS__
+
+struct TypeStats {
+    std::string name;
+    std::atomic<size_t> allocations = 0;
+    std::atomic<size_t> deallocations = 0;
+    std::atomic<size_t> live = 0;
+    std::atomic<size_t> peak_live = 0;
+    std::atomic<size_t> strong_increments = 0;
+    std::atomic<size_t> strong_decrements = 0;
+    std::atomic<size_t> weak_increments = 0;
+    std::atomic<size_t> weak_decrements = 0;
+    std::atomic<size_t> copies = 0;
+    std::atomic<size_t> moves = 0;
+    std::atomic<size_t> failed_locks = 0;
+};
+
+struct TypeStatsSnapshot {
+    std::string name;
+    size_t allocations;
+    size_t deallocations;
+    size_t live;
+    size_t peak_live;
+    size_t strong_increments;
+    size_t strong_decrements;
+    size_t weak_increments;
+    size_t weak_decrements;
+    size_t copies;
+    size_t moves;
+    size_t failed_locks;
+};
+
+class Instrumentation {
+public:
+    template <typename T>
+    static TypeStats* For() {
+        return Registered<std::remove_cv_t<T>>();
+    }
+
+    static void Add(TypeStats* stats, std::atomic<size_t> TypeStats::*field, size_t n = 1) {
+        if (stats != nullptr) {
+            (stats->*field).fetch_add(n, std::memory_order_relaxed);
+        }
+    }
+
+    static void Created(TypeStats* stats) {
+        Add(stats, &TypeStats::allocations);
+        size_t live = stats->live.fetch_add(1, std::memory_order_relaxed) + 1;
+        size_t peak = stats->peak_live.load(std::memory_order_relaxed);
+        while (live > peak && !stats->peak_live.compare_exchange_weak(peak, live,
+                                                                      std::memory_order_relaxed)) {
+        }
+    }
+
+    static void Destroyed(TypeStats* stats) {
+        stats->live.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    static void Deallocated(TypeStats* stats) {
+        Add(stats, &TypeStats::deallocations);
+    }
+
+    template <typename Block>
+    static void Copied(const Block* block) {
+        if (block != nullptr) {
+            Add(block->Stats(), &TypeStats::copies);
+        }
+    }
+
+    template <typename Block>
+    static void Moved(const Block* block) {
+        if (block != nullptr) {
+            Add(block->Stats(), &TypeStats::moves);
+        }
+    }
+
+    template <typename T>
+    static void AddFor(const T* object, std::atomic<size_t> TypeStats::*field) {
+        if (object != nullptr) {
+            Add(For<T>(), field);
+        }
+    }
+
+    // Sorted by allocations, busiest type first.
+    static std::vector<TypeStatsSnapshot> Snapshot() {
+        std::vector<TypeStatsSnapshot> result;
+        {
+            std::lock_guard lock(GetRegistry().mutex);
+            for (TypeStats* s : GetRegistry().types) {
+                auto load = [](const std::atomic<size_t>& value) {
+                    return value.load(std::memory_order_relaxed);
+                };
+                result.push_back({s->name, load(s->allocations), load(s->deallocations),
+                                  load(s->live), load(s->peak_live), load(s->strong_increments),
+                                  load(s->strong_decrements), load(s->weak_increments),
+                                  load(s->weak_decrements), load(s->copies), load(s->moves),
+                                  load(s->failed_locks)});
+            }
+        }
+        std::sort(result.begin(), result.end(), [](const auto& a, const auto& b) {
+            return a.allocations > b.allocations;
+        });
+        return result;
+    }
+
+    static void Dump(std::FILE* out = stderr) {
+        std::fprintf(out, "type,allocations,deallocations,live,peak_live,strong_inc,strong_dec,"
+                          "weak_inc,weak_dec,copies,moves,failed_locks\n");
+        for (const TypeStatsSnapshot& s : Snapshot()) {
+            std::fprintf(out, "\"%s\",%zu,%zu,%zu,%zu,%zu,%zu,%zu,%zu,%zu,%zu,%zu\n",
+                         s.name.c_str(), s.allocations, s.deallocations, s.live, s.peak_live,
+                         s.strong_increments, s.strong_decrements, s.weak_increments,
+                         s.weak_decrements, s.copies, s.moves, s.failed_locks);
+        }
+    }
+
+private:
+    struct Registry {
+        std::mutex mutex;
+        std::vector<TypeStats*> types;
+    };
+
+    // Never destroyed: pointers with static storage may still report after exit begins.
+    static Registry& GetRegistry() {
+        static auto registry = new Registry;
+        return *registry;
+    }
+
+    template <typename T>
+    static TypeStats* Registered() {
+        static TypeStats* stats = Register(typeid(T).name());
+        return stats;
+    }
+
+    static TypeStats* Register(const char* mangled) {
+        auto stats = new TypeStats;
+        stats->name = mangled;
+#if defined(__GNUG__)
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(mangled, nullptr, nullptr, &status);
+        if (status == 0) {
+            stats->name = demangled;
+        }
+        std::free(demangled);
+#endif
+        std::lock_guard lock(GetRegistry().mutex);
+        GetRegistry().types.push_back(stats);
+        return stats;
+    }
+};
+
+#else
+
+#include <cstdio>
+
+#define SMART_POINTERS_INSTRUMENT(...)
+
+struct TypeStats;
+
+class Instrumentation {
+public:
+    static void Dump(std::FILE* = stderr) {
+    }
+};
+
+#endif
@@ -1,5 +1,9 @@
 #pragma once
 
+#include "instrumentation.h"
+#include "policy.h"
+
+#include <atomic>
 #include <cstddef>
 #include <utility>
 
@@ -10,8 +14,15 @@ public:
     void IncRef() {
         count_++;
     }
-    void DecRef() {
-        count_--;
+    void IncRef(size_t n) {
+        count_ += n;
+    }
+    size_t DecRef() {
+        return --count_;
+    }
+    size_t DecRef(size_t n) {
+        assert(count_ >= n);
+        return count_ -= n;
     }
     size_t RefCount() const {
         return count_;
@@ -21,6 +32,45 @@ private:
     size_t count_ = 0;
 };
 
+class AtomicCounter {
+public:
+    void IncRef() {
+        count_.fetch_add(1, std::memory_order_relaxed);
+    }
+    void IncRef(size_t n) {
+        count_.fetch_add(n, std::memory_order_relaxed);
+    }
+    size_t DecRef() {
+        return count_.fetch_sub(1, std::memory_order_acq_rel) - 1;
+    }
+    size_t DecRef(size_t n) {
+        size_t old = count_.fetch_sub(n, std::memory_order_acq_rel);
+        assert(old >= n);
+        return old - n;
+    }
+    size_t RefCount() const {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<size_t> count_ = 0;
+};
+
+template <typename Counter>
+struct RefCounterTraits {
+    using Type = Counter;
+};
+
+template <>
+struct RefCounterTraits<SingleThreaded> {
+    using Type = SimpleCounter;
+};
+
+template <>
+struct RefCounterTraits<MultiThreaded> {
+    using Type = AtomicCounter;
+};
+
 struct DefaultDelete {
     template <typename T>
     static void Destroy(T* object) {
@@ -34,6 +84,13 @@ public:
 
     void IncRef() {
         counter_.IncRef();
+        SMART_POINTERS_INSTRUMENT(Track(1);)
+    }
+
+    // Takes or drops n references with a single counter update.
+    void IncRef(size_t n) {
+        counter_.IncRef(n);
+        SMART_POINTERS_INSTRUMENT(Track(n);)
     }
 
     RefCounted& operator=(const RefCounted& other) {
@@ -41,8 +98,17 @@ public:
     }
 
     void DecRef() {
-        counter_.DecRef();
-        if (counter_.RefCount() == 0) {
+        SMART_POINTERS_INSTRUMENT(Untrack(1);)
+        if (counter_.DecRef() == 0) {
+            SMART_POINTERS_INSTRUMENT(Destroyed();)
+            Deleter::Destroy(static_cast<Derived*>(this));
+        }
+    }
+
+    void DecRef(size_t n) {
+        SMART_POINTERS_INSTRUMENT(Untrack(n);)
+        if (n != 0 && counter_.DecRef(n) == 0) {
+            SMART_POINTERS_INSTRUMENT(Destroyed();)
             Deleter::Destroy(static_cast<Derived*>(this));
         }
     }
@@ -52,12 +118,35 @@ public:
     }
 
 private:
-    Counter counter_;
+#ifdef SMART_POINTERS_INSTRUMENTATION
+    // The first reference marks the object as allocated: nobody else can hold it yet.
+    void Track(size_t n) {
+        TypeStats* stats = Instrumentation::For<Derived>();
+        Instrumentation::Add(stats, &TypeStats::strong_increments, n);
+        if (counter_.RefCount() == n) {
+            Instrumentation::Created(stats);
+        }
+    }
+
+    void Untrack(size_t n) {
+        Instrumentation::Add(Instrumentation::For<Derived>(), &TypeStats::strong_decrements, n);
+    }
+
+    void Destroyed() {
+        Instrumentation::Destroyed(Instrumentation::For<Derived>());
+        Instrumentation::Deallocated(Instrumentation::For<Derived>());
+    }
+#endif
+
+    typename RefCounterTraits<Counter>::Type counter_;
 };
 
 template <typename Derived, typename D = DefaultDelete>
 using SimpleRefCounted = RefCounted<Derived, SimpleCounter, D>;
 
+template <typename Derived, typename D = DefaultDelete>
+using ThreadSafeRefCounted = RefCounted<Derived, MultiThreaded, D>;
+
 template <typename T>
 class IntrusivePtr {
     template <typename Y>
@@ -65,10 +154,10 @@ class IntrusivePtr {
 
 public:
 
-    IntrusivePtr() : ptr_(nullptr) {
+    IntrusivePtr() noexcept : ptr_(nullptr) {
     }
 
-    IntrusivePtr(std::nullptr_t) : ptr_(nullptr) {
+    IntrusivePtr(std::nullptr_t) noexcept : ptr_(nullptr) {
     }
 
     IntrusivePtr(T* ptr) : ptr_(ptr) {
@@ -82,17 +171,32 @@ public:
         if (ptr_ != nullptr) {
             ptr_->IncRef();
         }
+        SMART_POINTERS_INSTRUMENT(Instrumentation::AddFor(ptr_, &TypeStats::copies);)
     }
 
     template <typename Y>
-    IntrusivePtr(IntrusivePtr<Y>&& other) : ptr_(std::move(other.ptr_)) {
+    IntrusivePtr(IntrusivePtr<Y>&& other) noexcept : ptr_(other.ptr_) {
         other.ptr_ = nullptr;
+        SMART_POINTERS_INSTRUMENT(Instrumentation::AddFor(ptr_, &TypeStats::moves);)
     }
 
     IntrusivePtr(const IntrusivePtr& other) : ptr_(other.ptr_) {
         if (ptr_ != nullptr) {
             ptr_->IncRef();
         }
+        SMART_POINTERS_INSTRUMENT(Instrumentation::AddFor(ptr_, &TypeStats::copies);)
+    }
+
+    IntrusivePtr(IntrusivePtr&& other) noexcept : ptr_(other.ptr_) {
+        other.ptr_ = nullptr;
+        SMART_POINTERS_INSTRUMENT(Instrumentation::AddFor(ptr_, &TypeStats::moves);)
+    }
+
+    // Wraps a reference the caller already owns, e.g. one of n taken by IncRef(n).
+    static IntrusivePtr Adopt(T* ptr) noexcept {
+        IntrusivePtr result;
+        result.ptr_ = ptr;
+        return result;
     }
 
     IntrusivePtr& operator=(const IntrusivePtr& other) {
@@ -109,15 +213,14 @@ public:
         return *this;
     }
 
-    IntrusivePtr& operator=(IntrusivePtr&& other) {
-        if (ptr_ == other.ptr_) {
-            return *this;
-        }
-        if (ptr_ != nullptr) {
-            ptr_->DecRef();
-        }
-        ptr_ = std::move(other.ptr_);
-        other.ptr_ = nullptr;
+    IntrusivePtr& operator=(IntrusivePtr&& other) noexcept {
+        IntrusivePtr(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    template <typename Y>
+    IntrusivePtr& operator=(IntrusivePtr<Y>&& other) noexcept {
+        IntrusivePtr(std::move(other)).Swap(*this);
         return *this;
     }
 
@@ -144,10 +247,15 @@ public:
         }
     }
 
-    void Swap(IntrusivePtr& other) {
+    void Swap(IntrusivePtr& other) noexcept {
         std::swap(ptr_, other.ptr_);
     }
 
+    // Gives up ownership without touching the count, so references can be dropped in bulk.
+    T* Release() noexcept {
+        return std::exchange(ptr_, nullptr);
+    }
+
     T* Get() const {
         return ptr_;
     }
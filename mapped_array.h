@@ -0,0 +1,117 @@
+#pragma once
+
+#include "unique.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+struct MappedArrayOptions {
+    // Aligns the array to 2 MiB and asks for transparent huge pages with madvise.
+    bool huge_pages = false;
+    // Faults every page in up front instead of on first touch.
+    bool populate = false;
+};
+
+// Large arrays backed directly by an anonymous mapping. The page in front of the array
+// records the mapping, so the deleter stays stateless and UniquePtr stays one word.
+class MappedArray {
+public:
+    static constexpr size_t kHugePageSize = size_t(2) << 20;
+
+    static void* Map(size_t bytes, MappedArrayOptions options) {
+        size_t page = PageSize();
+        size_t data_bytes = RoundUp(bytes, page);
+        size_t slack = options.huge_pages ? kHugePageSize : 0;
+        size_t length = page + data_bytes + slack;
+
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_POPULATE
+        // With huge pages the region is populated after madvise, or it would get small pages.
+        if (options.populate && !options.huge_pages) {
+            flags |= MAP_POPULATE;
+        }
+#endif
+        void* raw = mmap(nullptr, length, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (raw == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+
+        auto start = reinterpret_cast<uintptr_t>(raw);
+        uintptr_t data = start + page;
+        if (options.huge_pages) {
+            data = RoundUp(data, kHugePageSize);
+            uintptr_t base = data - page;
+            uintptr_t end = data + data_bytes;
+            if (base != start) {
+                munmap(raw, base - start);
+            }
+            if (end != start + length) {
+                munmap(reinterpret_cast<void*>(end), start + length - end);
+            }
+            start = base;
+            length = page + data_bytes;
+#ifdef MADV_HUGEPAGE
+            madvise(reinterpret_cast<void*>(data), data_bytes, MADV_HUGEPAGE);
+#endif
+            if (options.populate) {
+                for (size_t offset = 0; offset < data_bytes; offset += page) {
+                    reinterpret_cast<volatile char*>(data)[offset] = 0;
+                }
+            }
+        }
+
+        Header* header = reinterpret_cast<Header*>(data) - 1;
+        header->base = reinterpret_cast<void*>(start);
+        header->length = length;
+        return reinterpret_cast<void*>(data);
+    }
+
+    static void Unmap(void* data) {
+        const Header* header = static_cast<const Header*>(data) - 1;
+        munmap(header->base, header->length);
+    }
+
+private:
+    struct Header {
+        void* base;
+        size_t length;
+    };
+
+    static size_t PageSize() {
+        static const size_t page = sysconf(_SC_PAGESIZE);
+        return page;
+    }
+
+    static size_t RoundUp(size_t value, size_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+};
+
+template <typename T>
+struct MappedArrayDeleter {
+    void operator()(T* ptr) const {
+        if (ptr != nullptr) {
+            MappedArray::Unmap(ptr);
+        }
+    }
+};
+
+// Elements start zeroed, as anonymous pages do, and are never destroyed.
+template <typename T>
+std::enable_if_t<std::is_array_v<T> && std::extent_v<T> == 0,
+                 UniquePtr<T, MappedArrayDeleter<std::remove_extent_t<T>>>>
+MakeUniqueMapped(size_t n, MappedArrayOptions options = {}) {
+    using Element = std::remove_extent_t<T>;
+    static_assert(std::is_trivially_default_constructible_v<Element>);
+    static_assert(std::is_trivially_destructible_v<Element>);
+    if (n > (SIZE_MAX - MappedArray::kHugePageSize) / sizeof(Element) / 2) {
+        throw std::bad_array_new_length();
+    }
+    auto ptr = static_cast<Element*>(MappedArray::Map(n * sizeof(Element), options));
+    return UniquePtr<T, MappedArrayDeleter<Element>>(ptr);
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+enum class StrongRelease { kAlive, kLastStrong, kLastReference };
+
+// Both counts live in one 64-bit word: strong in the low half, weak in the high half.
+// Weak includes one extra reference held collectively by all strong owners, so dropping
+// the last strong reference with no weak references left turns the word into zero.
+class PackedCounts {
+public:
+    static constexpr uint64_t kStrongOne = 1;
+    static constexpr uint64_t kWeakOne = uint64_t(1) << 32;
+    static constexpr uint64_t kInitial = kWeakOne;
+    static constexpr uint64_t kMax = UINT32_MAX;
+
+    static size_t Strong(uint64_t word) {
+        return word & kMax;
+    }
+
+    static size_t Weak(uint64_t word) {
+        return word >> 32;
+    }
+
+    static StrongRelease Released(uint64_t old) {
+        assert(Strong(old) != 0);
+        if (old == kStrongOne + kWeakOne) {
+            return StrongRelease::kLastReference;
+        }
+        return Strong(old) == 1 ? StrongRelease::kLastStrong : StrongRelease::kAlive;
+    }
+};
+
+struct SingleThreaded {
+    class Counters {
+    public:
+        size_t GetStrong() const {
+            return PackedCounts::Strong(word_);
+        }
+
+        size_t GetWeak() const {
+            return PackedCounts::Weak(word_);
+        }
+
+        void IncStrong() {
+            assert(PackedCounts::Strong(word_) != PackedCounts::kMax);
+            word_ += PackedCounts::kStrongOne;
+        }
+
+        void IncWeak() {
+            assert(PackedCounts::Weak(word_) != PackedCounts::kMax);
+            word_ += PackedCounts::kWeakOne;
+        }
+
+        bool TryIncStrong() {
+            if (PackedCounts::Strong(word_) == 0) {
+                return false;
+            }
+            IncStrong();
+            return true;
+        }
+
+        StrongRelease DecStrong() {
+            uint64_t old = word_;
+            word_ -= PackedCounts::kStrongOne;
+            return PackedCounts::Released(old);
+        }
+
+        bool DecWeak() {
+            word_ -= PackedCounts::kWeakOne;
+            return word_ == 0;
+        }
+
+    private:
+        uint64_t word_ = PackedCounts::kInitial;
+    };
+};
+
+struct MultiThreaded {
+    class Counters {
+    public:
+        size_t GetStrong() const {
+            return PackedCounts::Strong(word_.load(std::memory_order_acquire));
+        }
+
+        size_t GetWeak() const {
+            return PackedCounts::Weak(word_.load(std::memory_order_acquire));
+        }
+
+        void IncStrong() {
+            [[maybe_unused]] uint64_t old =
+                word_.fetch_add(PackedCounts::kStrongOne, std::memory_order_relaxed);
+            assert(PackedCounts::Strong(old) != PackedCounts::kMax);
+        }
+
+        void IncWeak() {
+            [[maybe_unused]] uint64_t old =
+                word_.fetch_add(PackedCounts::kWeakOne, std::memory_order_relaxed);
+            assert(PackedCounts::Weak(old) != PackedCounts::kMax);
+        }
+
+        bool TryIncStrong() {
+            uint64_t word = word_.load(std::memory_order_relaxed);
+            do {
+                if (PackedCounts::Strong(word) == 0) {
+                    return false;
+                }
+                assert(PackedCounts::Strong(word) != PackedCounts::kMax);
+            } while (!word_.compare_exchange_weak(word, word + PackedCounts::kStrongOne,
+                                                  std::memory_order_acq_rel,
+                                                  std::memory_order_relaxed));
+            return true;
+        }
+
+        StrongRelease DecStrong() {
+            return PackedCounts::Released(
+                word_.fetch_sub(PackedCounts::kStrongOne, std::memory_order_acq_rel));
+        }
+
+        bool DecWeak() {
+            return word_.fetch_sub(PackedCounts::kWeakOne, std::memory_order_acq_rel) ==
+                   PackedCounts::kWeakOne;
+        }
+
+    private:
+        std::atomic<uint64_t> word_ = PackedCounts::kInitial;
+    };
+};
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "intrusive.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Per-thread log of reference drops not yet applied to their counters. A drop is only
+// recorded; a later IncRef of the same object on this thread cancels it, and anything left
+// is applied as one bulk DecRef at Flush(), on eviction from the log and at thread exit.
+// Increments are never deferred, so a counter only ever overestimates and an object cannot
+// be destroyed while another thread still holds it. UseCount() includes pending drops.
+class RefCountLog {
+public:
+    using Release = void (*)(void*, size_t);
+
+    // Cancels up to n pending drops of the object; returns how many it cancelled.
+    static size_t Cancel(void* object, size_t n = 1) {
+        Log* log = Local();
+        if (log == nullptr) {
+            return 0;
+        }
+        Entry& entry = Slot(*log, object);
+        if (entry.object != object) {
+            return 0;
+        }
+        size_t cancelled = entry.pending < n ? entry.pending : n;
+        entry.pending -= cancelled;
+        return cancelled;
+    }
+
+    // The new drop takes the slot before the one it displaces is applied: that release can run
+    // destructors which defer further drops into the same slot.
+    static void Defer(void* object, Release release, size_t n = 1) {
+        Log* log = Local();
+        if (log == nullptr) {
+            release(object, n);
+            return;
+        }
+        Entry& entry = Slot(*log, object);
+        if (entry.object == object && entry.pending != 0) {
+            entry.pending += n;
+            return;
+        }
+        Entry evicted = entry;
+        entry = {object, release, n};
+        if (evicted.pending != 0) {
+            evicted.release(evicted.object, evicted.pending);
+        }
+    }
+
+    // Destructors run by a flush may defer further drops, so keep going until none remain.
+    static void Flush() {
+        Log* log = Local();
+        if (log == nullptr) {
+            return;
+        }
+        bool evicted = true;
+        while (evicted) {
+            evicted = false;
+            for (Entry& entry : log->entries) {
+                evicted |= Evict(entry);
+            }
+        }
+    }
+
+private:
+    static constexpr size_t kSizeLog = 8;
+
+    struct Entry {
+        void* object = nullptr;
+        Release release = nullptr;
+        size_t pending = 0;
+    };
+
+    struct Log {
+        ~Log() {
+            Flush();
+            LogDestroyed() = true;
+        }
+
+        Entry entries[size_t(1) << kSizeLog];
+    };
+
+    // Drops may arrive from other thread_local destructors after the log is gone; they are
+    // then applied directly.
+    static Log* Local() {
+        if (LogDestroyed()) {
+            return nullptr;
+        }
+        static thread_local Log log;
+        return &log;
+    }
+
+    // Trivially destructible, so it stays readable for the whole life of the thread.
+    static bool& LogDestroyed() {
+        static thread_local bool destroyed = false;
+        return destroyed;
+    }
+
+    static Entry& Slot(Log& log, void* object) {
+        uint64_t hash = reinterpret_cast<uintptr_t>(object) * 0x9e3779b97f4a7c15ull;
+        return log.entries[hash >> (64 - kSizeLog)];
+    }
+
+    static bool Evict(Entry& entry) {
+        if (entry.pending == 0) {
+            return false;
+        }
+        Entry evicted = entry;
+        entry = Entry();
+        evicted.release(evicted.object, evicted.pending);
+        return true;
+    }
+};
+
+class RefCountFlushScope {
+public:
+    RefCountFlushScope() = default;
+
+    RefCountFlushScope(const RefCountFlushScope&) = delete;
+    RefCountFlushScope& operator=(const RefCountFlushScope&) = delete;
+
+    ~RefCountFlushScope() {
+        RefCountLog::Flush();
+    }
+};
+
+template <typename Derived, typename Counter = MultiThreaded, typename Deleter = DefaultDelete>
+class DeferredRefCounted : public RefCounted<Derived, Counter, Deleter> {
+    using Base = RefCounted<Derived, Counter, Deleter>;
+
+public:
+
+    void IncRef() {
+        if (RefCountLog::Cancel(this) == 0) {
+            Base::IncRef();
+        }
+    }
+
+    void IncRef(size_t n) {
+        if (size_t rest = n - RefCountLog::Cancel(this, n)) {
+            Base::IncRef(rest);
+        }
+    }
+
+    void DecRef() {
+        RefCountLog::Defer(this, &Release);
+    }
+
+    void DecRef(size_t n) {
+        if (n != 0) {
+            RefCountLog::Defer(this, &Release, n);
+        }
+    }
+
+private:
+    static void Release(void* object, size_t n) {
+        static_cast<DeferredRefCounted*>(object)->Base::DecRef(n);
+    }
+};
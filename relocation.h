@@ -0,0 +1,268 @@
+#pragma once
+
+#include "compressed_pair.h"
+#include "intrusive.h"
+#include "shared.h"
+#include "thin_shared.h"
+#include "unique.h"
+#include "weak.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// A type is trivially relocatable when moving it to new storage and destroying the source
+// is the same as copying its bytes and forgetting the source. None of the smart pointers
+// keep their own address anywhere, so all of them qualify; InlineUniquePtr does not.
+template <typename T>
+struct IsTriviallyRelocatable : std::bool_constant<std::is_trivially_copyable_v<T>> {};
+
+template <typename T1, typename T2, bool C1, bool C2, bool S>
+struct IsTriviallyRelocatable<CompressedPair<T1, T2, C1, C2, S>>
+    : std::bool_constant<IsTriviallyRelocatable<T1>::value &&
+                         IsTriviallyRelocatable<T2>::value> {};
+
+template <typename T, typename Deleter>
+struct IsTriviallyRelocatable<UniquePtr<T, Deleter>> : IsTriviallyRelocatable<Deleter> {};
+
+template <typename T, typename Policy>
+struct IsTriviallyRelocatable<SharedPtr<T, Policy>> : std::true_type {};
+
+template <typename T, typename Policy>
+struct IsTriviallyRelocatable<WeakPtr<T, Policy>> : std::true_type {};
+
+template <typename T, typename Policy>
+struct IsTriviallyRelocatable<ThinSharedPtr<T, Policy>> : std::true_type {};
+
+template <typename T, typename Policy>
+struct IsTriviallyRelocatable<ThinWeakPtr<T, Policy>> : std::true_type {};
+
+template <typename T>
+struct IsTriviallyRelocatable<IntrusivePtr<T>> : std::true_type {};
+
+// Vector that moves trivially relocatable elements with memcpy/memmove on growth, insertion
+// and erase; other types go through their move constructors as in std::vector.
+template <typename T>
+class RelocatingVector {
+    static constexpr bool kRelocatable = IsTriviallyRelocatable<T>::value;
+
+public:
+
+    RelocatingVector() = default;
+
+    RelocatingVector(const RelocatingVector& other) {
+        Reserve(other.size_);
+        try {
+            for (size_t i = 0; i < other.size_; ++i) {
+                PushBack(other.data_[i]);
+            }
+        } catch (...) {
+            Clear();
+            Deallocate(data_);
+            throw;
+        }
+    }
+
+    RelocatingVector(RelocatingVector&& other) noexcept
+        : data_(std::exchange(other.data_, nullptr)),
+          size_(std::exchange(other.size_, 0)),
+          capacity_(std::exchange(other.capacity_, 0)) {
+    }
+
+    RelocatingVector& operator=(const RelocatingVector& other) {
+        RelocatingVector(other).Swap(*this);
+        return *this;
+    }
+
+    RelocatingVector& operator=(RelocatingVector&& other) noexcept {
+        RelocatingVector(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    ~RelocatingVector() {
+        Clear();
+        Deallocate(data_);
+    }
+
+    template <typename... Args>
+    T& EmplaceBack(Args&&... args) {
+        if (size_ == capacity_) {
+            // The new element is built first: the arguments may refer to current elements.
+            T* data = Allocate(NextCapacity());
+            try {
+                new (data + size_) T(std::forward<Args>(args)...);
+            } catch (...) {
+                Deallocate(data);
+                throw;
+            }
+            Relocate(data_, size_, data);
+            Deallocate(data_);
+            data_ = data;
+            capacity_ = NextCapacity();
+        } else {
+            new (data_ + size_) T(std::forward<Args>(args)...);
+        }
+        return data_[size_++];
+    }
+
+    void PushBack(const T& value) {
+        EmplaceBack(value);
+    }
+
+    void PushBack(T&& value) {
+        EmplaceBack(std::move(value));
+    }
+
+    void PopBack() {
+        data_[--size_].~T();
+    }
+
+    T& Insert(size_t index, T value) {
+        if (index == size_) {
+            return EmplaceBack(std::move(value));
+        }
+        if constexpr (kRelocatable) {
+            Reserve(size_ == capacity_ ? NextCapacity() : capacity_);
+            T* hole = data_ + index;
+            std::memmove(static_cast<void*>(hole + 1), static_cast<const void*>(hole),
+                         (size_ - index) * sizeof(T));
+            try {
+                new (hole) T(std::move(value));
+            } catch (...) {
+                std::memmove(static_cast<void*>(hole), static_cast<const void*>(hole + 1),
+                             (size_ - index) * sizeof(T));
+                throw;
+            }
+            ++size_;
+        } else {
+            EmplaceBack(std::move(value));
+            std::rotate(data_ + index, data_ + size_ - 1, data_ + size_);
+        }
+        return data_[index];
+    }
+
+    void Erase(size_t index) {
+        if constexpr (kRelocatable) {
+            T* hole = data_ + index;
+            hole->~T();
+            std::memmove(static_cast<void*>(hole), static_cast<const void*>(hole + 1),
+                         (size_ - index - 1) * sizeof(T));
+            --size_;
+        } else {
+            std::move(data_ + index + 1, data_ + size_, data_ + index);
+            PopBack();
+        }
+    }
+
+    void Reserve(size_t capacity) {
+        if (capacity <= capacity_) {
+            return;
+        }
+        T* data = Allocate(capacity);
+        Relocate(data_, size_, data);
+        Deallocate(data_);
+        data_ = data;
+        capacity_ = capacity;
+    }
+
+    void Clear() {
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            for (size_t i = 0; i < size_; ++i) {
+                data_[i].~T();
+            }
+        }
+        size_ = 0;
+    }
+
+    void Swap(RelocatingVector& other) noexcept {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        std::swap(capacity_, other.capacity_);
+    }
+
+    T& operator[](size_t index) {
+        return data_[index];
+    }
+
+    const T& operator[](size_t index) const {
+        return data_[index];
+    }
+
+    T* Data() {
+        return data_;
+    }
+
+    const T* Data() const {
+        return data_;
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+    size_t Capacity() const {
+        return capacity_;
+    }
+
+    bool Empty() const {
+        return size_ == 0;
+    }
+
+    T* begin() {
+        return data_;
+    }
+
+    T* end() {
+        return data_ + size_;
+    }
+
+    const T* begin() const {
+        return data_;
+    }
+
+    const T* end() const {
+        return data_ + size_;
+    }
+
+private:
+    size_t NextCapacity() const {
+        return capacity_ == 0 ? 4 : capacity_ * 2;
+    }
+
+    static T* Allocate(size_t capacity) {
+        if (capacity > SIZE_MAX / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        void* data = ::operator new(capacity * sizeof(T), std::align_val_t(alignof(T)));
+        return static_cast<T*>(data);
+    }
+
+    static void Deallocate(T* data) {
+        ::operator delete(data, std::align_val_t(alignof(T)));
+    }
+
+    // Moves `size` elements into uninitialized storage and ends the lifetime of the source.
+    static void Relocate(T* from, size_t size, T* to) {
+        if constexpr (kRelocatable) {
+            if (size != 0) {
+                std::memcpy(static_cast<void*>(to), static_cast<const void*>(from),
+                            size * sizeof(T));
+            }
+        } else {
+            static_assert(std::is_nothrow_move_constructible_v<T>,
+                          "RelocatingVector needs trivially relocatable or nothrow-movable T");
+            for (size_t i = 0; i < size; ++i) {
+                new (to + i) T(std::move(from[i]));
+                from[i].~T();
+            }
+        }
+    }
+
+    T* data_ = nullptr;
+    size_t size_ = 0;
+    size_t capacity_ = 0;
+};
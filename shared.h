@@ -9,60 +9,122 @@
 
 class EnableSharedFromThisBase {};
 
-template <typename T>
+// Keeps one pointer to the control block instead of two WeakPtrs. The pointer owns a weak
+// reference, so the last strong release always takes the kLastStrong path and the block
+// survives a WeakFromThis() called from the object's own destructor.
+template <typename T, typename Policy = SingleThreaded>
 class EnableSharedFromThis : public EnableSharedFromThisBase {
 public:
-    SharedPtr<T> SharedFromThis() {
-        return SharedPtr(weak_this_);
+    using SharedFromThisType = T;
+    using SharedFromThisPolicy = Policy;
+
+    SharedPtr<T, Policy> SharedFromThis() {
+        return LockThis(static_cast<T*>(this));
+    }
+
+    SharedPtr<const T, Policy> SharedFromThis() const {
+        return LockThis(static_cast<const T*>(this));
+    }
+
+    WeakPtr<T, Policy> WeakFromThis() noexcept {
+        return WeakThis(static_cast<T*>(this));
+    }
+
+    WeakPtr<const T, Policy> WeakFromThis() const noexcept {
+        return WeakThis(static_cast<const T*>(this));
     }
 
-    SharedPtr<const T> SharedFromThis() const {
-        return SharedPtr(const_weak_this_);
+protected:
+    EnableSharedFromThis() noexcept = default;
+
+    EnableSharedFromThis(const EnableSharedFromThis&) noexcept {
     }
 
-    WeakPtr<T> WeakFromThis() noexcept {
-        return weak_this_;
+    EnableSharedFromThis& operator=(const EnableSharedFromThis&) noexcept {
+        return *this;
     }
 
-    WeakPtr<const T> WeakFromThis() const noexcept {
-        return const_weak_this_;
+    ~EnableSharedFromThis() {
+        if (this_block_ != nullptr) {
+            this_block_->DecWCounter();
+        }
     }
 
 private:
-    WeakPtr<T> weak_this_;
-    WeakPtr<const T> const_weak_this_;
+    template <typename U>
+    SharedPtr<U, Policy> LockThis(U* self) const {
+        if (this_block_ == nullptr || !this_block_->TryIncSCounter()) {
+            throw BadWeakPtr();
+        }
+        SharedPtr<U, Policy> result;
+        result.ptr_ = self;
+        result.block_ = this_block_;
+        return result;
+    }
 
-    template <typename Y>
+    template <typename U>
+    WeakPtr<U, Policy> WeakThis(U* self) const noexcept {
+        WeakPtr<U, Policy> result;
+        if (this_block_ != nullptr) {
+            this_block_->IncWCounter();
+            result.ptr_ = self;
+            result.block_ = this_block_;
+        }
+        return result;
+    }
+
+    ControlBlockBase<Policy>* this_block_ = nullptr;
+
+    template <typename Y, typename P>
     friend class SharedPtr;
 };
 
-template <typename T>
+template <typename T, typename Policy>
 class SharedPtr {
 public:
 
-    SharedPtr() : ptr_(nullptr), block_(nullptr) {
+    SharedPtr() noexcept : ptr_(nullptr), block_(nullptr) {
     }
 
-    SharedPtr(std::nullptr_t) : ptr_(nullptr), block_(nullptr) {
+    SharedPtr(std::nullptr_t) noexcept : ptr_(nullptr), block_(nullptr) {
     }
 
     template <typename Y>
-    explicit SharedPtr(Y* ptr) : ptr_(ptr), block_(new ControlBlockPointer<Y>(ptr)) {
+    explicit SharedPtr(Y* ptr) : ptr_(ptr), block_(new ControlBlockPointer<Y, Policy>(ptr)) {
         if (block_ != nullptr) {
             block_->IncSCounter();
         }
-        if constexpr (std::is_convertible_v<Y*, EnableSharedFromThisBase*>) {
-            ptr_->weak_this_ = WeakPtr<T>(*this);
-            ptr_->const_weak_this_ = WeakPtr<const T>(*this);
-        }
+        InitWeakThis(ptr);
     }
 
-    SharedPtr(ControlBlockHolder<T>* block) : ptr_(block->GetPointer()), block_(block) {
+    template <typename Y, typename Alloc>
+    SharedPtr(Y* ptr, const Alloc& alloc)
+        : ptr_(ptr), block_(ControlBlockAllocPointer<Y, Alloc, Policy>::Create(alloc, ptr)) {
         block_->IncSCounter();
-        if constexpr (std::is_convertible_v<T*, EnableSharedFromThisBase*>) {
-            ptr_->weak_this_ = WeakPtr<T>(*this);
-            ptr_->const_weak_this_ = WeakPtr<const T>(*this);
-        }
+        InitWeakThis(ptr);
+    }
+
+    SharedPtr(ControlBlockHolder<T, Policy>* block) : ptr_(block->GetPointer()), block_(block) {
+        block_->IncSCounter();
+        InitWeakThis(ptr_);
+    }
+
+    template <typename Alloc>
+    SharedPtr(ControlBlockAllocHolder<T, Alloc, Policy>* block)
+        : ptr_(block->GetPointer()), block_(block) {
+        block_->IncSCounter();
+        InitWeakThis(ptr_);
+    }
+
+    SharedPtr(ControlBlockEpochHolder<T, Policy>* block)
+        : ptr_(block->GetPointer()), block_(block) {
+        block_->IncSCounter();
+        InitWeakThis(ptr_);
+    }
+
+    SharedPtr(ControlBlockCollectableHolder<T>* block) : ptr_(block->GetPointer()), block_(block) {
+        block_->IncSCounter();
+        InitWeakThis(ptr_);
     }
 
     SharedPtr(const SharedPtr& other) {
@@ -71,75 +133,70 @@ public:
         if (block_ != nullptr) {
             block_->IncSCounter();
         }
+        SMART_POINTERS_INSTRUMENT(Instrumentation::Copied(block_);)
     }
 
     template <typename Y>
-    SharedPtr(const SharedPtr<Y>& other) {
+    SharedPtr(const SharedPtr<Y, Policy>& other) {
         ptr_ = other.ptr_;
         block_ = other.block_;
         if (block_ != nullptr) {
             block_->IncSCounter();
         }
+        SMART_POINTERS_INSTRUMENT(Instrumentation::Copied(block_);)
+    }
+
+    SharedPtr(SharedPtr&& other) noexcept : ptr_(other.ptr_), block_(other.block_) {
+        other.ptr_ = nullptr;
+        other.block_ = nullptr;
+        SMART_POINTERS_INSTRUMENT(Instrumentation::Moved(block_);)
     }
 
     template <typename Y>
-    SharedPtr(SharedPtr<Y>&& other) {
-        ptr_ = std::move(other.ptr_);
-        block_ = std::move(other.block_);
+    SharedPtr(SharedPtr<Y, Policy>&& other) noexcept : ptr_(other.ptr_), block_(other.block_) {
         other.ptr_ = nullptr;
         other.block_ = nullptr;
+        SMART_POINTERS_INSTRUMENT(Instrumentation::Moved(block_);)
     }
 
     template <typename Y>
-    SharedPtr(const SharedPtr<Y>& other, T* ptr) : ptr_(ptr), block_(other.block_) {
+    SharedPtr(const SharedPtr<Y, Policy>& other, T* ptr) : ptr_(ptr), block_(other.block_) {
         block_->IncSCounter();
+        SMART_POINTERS_INSTRUMENT(Instrumentation::Copied(block_);)
     }
 
-    explicit SharedPtr(const WeakPtr<T>& other) {
-        if (other.UseCount() == 0) {
+    explicit SharedPtr(const WeakPtr<T, Policy>& other) {
+        if (other.block_ == nullptr || !other.block_->TryIncSCounter()) {
             throw BadWeakPtr();
         }
         ptr_ = other.ptr_;
         block_ = other.block_;
-        if (block_ != nullptr) {
-            block_->IncSCounter();
-        }
     }
 
     SharedPtr& operator=(const SharedPtr& other) {
-        if (block_ != nullptr) {
-            block_->DecSCounter();
-        }
-        ptr_ = other.ptr_;
-        block_ = other.block_;
-        if (block_ != nullptr) {
-            block_->IncSCounter();
-        }
+        SharedPtr(other).Swap(*this);
         return *this;
     }
 
     template <typename Y>
-    SharedPtr& operator=(const SharedPtr<Y>& other) {
-        if (block_ != nullptr) {
-            block_->DecSCounter();
-        }
-        ptr_ = other.ptr_;
-        block_ = other.block_;
-        if (block_ != nullptr) {
-            block_->IncSCounter();
-        }
+    SharedPtr& operator=(const SharedPtr<Y, Policy>& other) {
+        SharedPtr(other).Swap(*this);
+        return *this;
+    }
+
+    SharedPtr& operator=(SharedPtr&& other) noexcept {
+        SharedPtr(std::move(other)).Swap(*this);
         return *this;
     }
 
     template <typename Y>
-    SharedPtr& operator=(SharedPtr<Y>&& other) {
-        if (block_ != nullptr) {
-            block_->DecSCounter();
-        }
-        ptr_ = std::move(other.ptr_);
-        block_ = std::move(other.block_);
-        other.ptr_ = nullptr;
-        other.block_ = nullptr;
+    SharedPtr& operator=(SharedPtr<Y, Policy>&& other) noexcept {
+        SharedPtr(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    SharedPtr& operator=(std::nullptr_t) noexcept {
+        Reset();
         return *this;
     }
 
@@ -150,36 +207,21 @@ public:
         block_->DecSCounter();
     }
 
-    void Reset() {
-        if (block_ == nullptr) {
-            return;
-        }
-        block_->DecSCounter();
-        ptr_ = nullptr;
-        block_ = nullptr;
+    void Reset() noexcept {
+        SharedPtr().Swap(*this);
     }
 
     template <typename Y>
     void Reset(Y* ptr) {
-        if (block_ != nullptr) {
-            block_->DecSCounter();
-        }
-        ptr_ = ptr;
-        block_ = new ControlBlockPointer<Y>(ptr);
-        if (block_ != nullptr) {
-            block_->IncSCounter();
-        }
+        SharedPtr(ptr).Swap(*this);
     }
 
-    void Swap(SharedPtr& other) {
+    void Swap(SharedPtr& other) noexcept {
         std::swap(ptr_, other.ptr_);
         std::swap(block_, other.block_);
     }
 
     T* Get() const {
-        if (block_ != nullptr && block_->GetSCounter() == 0) {
-            return nullptr;
-        }
         return ptr_;
     }
 
@@ -188,9 +230,6 @@ public:
     }
 
     T* operator->() const {
-        if (block_ != nullptr && block_->GetSCounter() == 0) {
-            return nullptr;
-        }
         return ptr_;
     }
 
@@ -206,34 +245,61 @@ public:
     }
 
 private:
+    template <typename Y>
+    void InitWeakThis(Y* ptr) {
+        if constexpr (std::is_convertible_v<Y*, EnableSharedFromThisBase*>) {
+            using Base = typename Y::SharedFromThisType;
+            static_assert(std::is_same_v<typename Y::SharedFromThisPolicy, Policy>);
+            if (ptr != nullptr) {
+                auto self = static_cast<EnableSharedFromThis<Base, Policy>*>(
+                    const_cast<std::remove_cv_t<Y>*>(ptr));
+                if (self->this_block_ == nullptr) {
+                    block_->IncWCounter();
+                    self->this_block_ = block_;
+                }
+            }
+        }
+    }
+
     T* ptr_ = nullptr;
-    ControlBlockBase* block_ = nullptr;
+    ControlBlockBase<Policy>* block_ = nullptr;
 
-    template <typename Y>
+    template <typename Y, typename P>
     friend class SharedPtr;
 
-    template <typename Y>
+    template <typename Y, typename P>
     friend class WeakPtr;
-};
 
-template <typename T, typename U>
-inline bool operator==(const SharedPtr<T>& left, const SharedPtr<U>& right) {
-    return (left.Get() == right.Get());
-}
+    template <typename Y>
+    friend class AtomicSharedPtr;
 
-template <typename T, typename... Args>
-SharedPtr<T> MakeShared(Args&&... args);
+    friend class CycleEdgeVisitor;
 
-template <typename T>
-class EnableSharedFromThis {
-public:
-    SharedPtr<T> SharedFromThis();
-    SharedPtr<const T> SharedFromThis() const;
+    template <typename Y, typename P>
+    friend class EnableSharedFromThis;
+
+    template <typename Y, typename P>
+    friend class ThinSharedPtr;
+
+    template <typename Y, typename P>
+    friend class ThinWeakPtr;
 
-    WeakPtr<T> WeakFromThis() noexcept;
-    WeakPtr<const T> WeakFromThis() const noexcept;
+    template <typename Y, typename P>
+    friend class EpochSlot;
 };
 
-SharedPtr<T> MakeShared(Args&&... args) {
-    return SharedPtr(new ControlBlockHolder<T>(std::forward<Args>(args)...));
+template <typename T, typename U, typename Policy>
+inline bool operator==(const SharedPtr<T, Policy>& left, const SharedPtr<U, Policy>& right) {
+    return (left.Get() == right.Get());
+}
+
+template <typename T, typename Policy = SingleThreaded, typename... Args>
+SharedPtr<T, Policy> MakeShared(Args&&... args) {
+    return SharedPtr<T, Policy>(new ControlBlockHolder<T, Policy>(std::forward<Args>(args)...));
+}
+
+template <typename T, typename Policy = SingleThreaded, typename Alloc, typename... Args>
+SharedPtr<T, Policy> AllocateShared(const Alloc& alloc, Args&&... args) {
+    return SharedPtr<T, Policy>(
+        ControlBlockAllocHolder<T, Alloc, Policy>::Create(alloc, std::forward<Args>(args)...));
 }
@@ -0,0 +1,241 @@
+#pragma once
+
+#include "shared.h"
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+
+struct SlabStats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t bytes_held = 0;
+
+    double HitRate() const {
+        size_t total = hits + misses;
+        return total == 0 ? 0.0 : static_cast<double>(hits) / total;
+    }
+};
+
+// Fixed-size slots are cached in a per-thread magazine; full and empty magazines are
+// balanced through a shared depot, so a slot freed on another thread is reused there.
+// Statistics are published when a magazine talks to the depot and may lag by one magazine.
+// Memory is never returned to the system on its own: freed slots wait in the depot until
+// Trim() releases them.
+template <size_t Size>
+class SlabPool {
+public:
+    static void* Allocate() {
+        Magazine* magazine = LocalMagazine();
+        if (magazine == nullptr) {
+            return AllocateFromDepot();
+        }
+        if (magazine->size == 0) {
+            Refill(*magazine);
+        }
+        if (magazine->size == 0) {
+            GetDepot().misses.fetch_add(1, std::memory_order_relaxed);
+            return ::operator new(Size);
+        }
+        ++magazine->hits;
+        return magazine->slots[--magazine->size];
+    }
+
+    static void Deallocate(void* ptr) {
+        Magazine* magazine = LocalMagazine();
+        if (magazine == nullptr) {
+            ReturnToDepot(ptr);
+            return;
+        }
+        if (magazine->size == kCapacity) {
+            Flush(*magazine, kCapacity / 2);
+        }
+        magazine->slots[magazine->size++] = ptr;
+    }
+
+    // Freed slots stay in the depot for reuse until trimmed; this hands all but `keep` of them
+    // back to the system. Slots cached in per-thread magazines are not touched.
+    static void Trim(size_t keep = 0) {
+        Depot& depot = GetDepot();
+        std::lock_guard lock(depot.mutex);
+        while (depot.size > keep) {
+            FreeSlot* slot = depot.head;
+            depot.head = slot->next;
+            --depot.size;
+            ::operator delete(slot);
+        }
+    }
+
+    static SlabStats GetStats() {
+        Depot& depot = GetDepot();
+        std::lock_guard lock(depot.mutex);
+        SlabStats stats;
+        stats.hits = depot.hits.load(std::memory_order_relaxed);
+        stats.misses = depot.misses.load(std::memory_order_relaxed);
+        stats.bytes_held = (depot.size + depot.cached.load(std::memory_order_relaxed)) * Size;
+        return stats;
+    }
+
+private:
+    static constexpr size_t kCapacity = 64;
+
+    struct FreeSlot {
+        FreeSlot* next;
+    };
+
+    struct Depot {
+        std::mutex mutex;
+        FreeSlot* head = nullptr;
+        size_t size = 0;
+        std::atomic<size_t> hits = 0;
+        std::atomic<size_t> misses = 0;
+        std::atomic<size_t> cached = 0;
+    };
+
+    struct Magazine {
+        ~Magazine() {
+            Flush(*this, size);
+            MagazineDestroyed() = true;
+        }
+
+        void* slots[kCapacity];
+        size_t size = 0;
+        size_t hits = 0;
+        size_t published = 0;
+    };
+
+    static_assert(Size >= sizeof(FreeSlot));
+
+    // Never destroyed: blocks may still be released from static destructors at exit.
+    static Depot& GetDepot() {
+        static auto depot = new Depot;
+        return *depot;
+    }
+
+    // A block released from a thread_local or static destructor may arrive after the
+    // magazine is gone; such calls go straight to the depot.
+    static Magazine* LocalMagazine() {
+        if (MagazineDestroyed()) {
+            return nullptr;
+        }
+        static thread_local Magazine magazine;
+        return &magazine;
+    }
+
+    // Trivially destructible, so it stays readable for the whole life of the thread.
+    static bool& MagazineDestroyed() {
+        static thread_local bool destroyed = false;
+        return destroyed;
+    }
+
+    static void* AllocateFromDepot() {
+        Depot& depot = GetDepot();
+        {
+            std::lock_guard lock(depot.mutex);
+            if (depot.head != nullptr) {
+                FreeSlot* slot = depot.head;
+                depot.head = slot->next;
+                --depot.size;
+                depot.hits.fetch_add(1, std::memory_order_relaxed);
+                return slot;
+            }
+        }
+        depot.misses.fetch_add(1, std::memory_order_relaxed);
+        return ::operator new(Size);
+    }
+
+    static void ReturnToDepot(void* ptr) {
+        Depot& depot = GetDepot();
+        std::lock_guard lock(depot.mutex);
+        auto slot = static_cast<FreeSlot*>(ptr);
+        slot->next = depot.head;
+        depot.head = slot;
+        ++depot.size;
+    }
+
+    static void Refill(Magazine& magazine) {
+        Depot& depot = GetDepot();
+        std::lock_guard lock(depot.mutex);
+        while (magazine.size < kCapacity / 2 && depot.head != nullptr) {
+            magazine.slots[magazine.size++] = depot.head;
+            depot.head = depot.head->next;
+            --depot.size;
+        }
+        Publish(depot, magazine);
+    }
+
+    static void Flush(Magazine& magazine, size_t count) {
+        Depot& depot = GetDepot();
+        std::lock_guard lock(depot.mutex);
+        for (size_t i = 0; i < count; ++i) {
+            auto slot = static_cast<FreeSlot*>(magazine.slots[--magazine.size]);
+            slot->next = depot.head;
+            depot.head = slot;
+            ++depot.size;
+        }
+        Publish(depot, magazine);
+    }
+
+    static void Publish(Depot& depot, Magazine& magazine) {
+        depot.hits.fetch_add(magazine.hits, std::memory_order_relaxed);
+        magazine.hits = 0;
+        depot.cached.fetch_add(magazine.size - magazine.published, std::memory_order_relaxed);
+        magazine.published = magazine.size;
+    }
+};
+
+template <typename T>
+using SlabPoolFor = SlabPool<(sizeof(T) + alignof(std::max_align_t) - 1) /
+                             alignof(std::max_align_t) * alignof(std::max_align_t)>;
+
+template <typename T>
+class SlabAllocator {
+public:
+    using value_type = T;
+
+    SlabAllocator() = default;
+
+    template <typename U>
+    SlabAllocator(const SlabAllocator<U>&) {
+    }
+
+    T* allocate(size_t n) {
+        static_assert(alignof(T) <= alignof(std::max_align_t));
+        if (n != 1) {
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+        return static_cast<T*>(SlabPoolFor<T>::Allocate());
+    }
+
+    void deallocate(T* ptr, size_t n) {
+        if (n != 1) {
+            ::operator delete(ptr);
+            return;
+        }
+        SlabPoolFor<T>::Deallocate(ptr);
+    }
+
+    static SlabStats GetStats() {
+        return SlabPoolFor<T>::GetStats();
+    }
+
+    static void Trim(size_t keep = 0) {
+        SlabPoolFor<T>::Trim(keep);
+    }
+
+    template <typename U>
+    bool operator==(const SlabAllocator<U>&) const {
+        return true;
+    }
+
+    template <typename U>
+    bool operator!=(const SlabAllocator<U>&) const {
+        return false;
+    }
+};
+
+template <typename T, typename Policy = SingleThreaded, typename... Args>
+SharedPtr<T, Policy> MakePooledShared(Args&&... args) {
+    return AllocateShared<T, Policy>(SlabAllocator<T>(), std::forward<Args>(args)...);
+}
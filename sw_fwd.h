@@ -1,100 +1,294 @@
 #pragma once
 
+#include "compressed_pair.h"
+#include "instrumentation.h"
+#include "policy.h"
+
+#include <cstddef>
 #include <exception>
+#include <new>
+#include <type_traits>
+#include <utility>
 #include <cassert>
 
 class BadWeakPtr : public std::exception {};
 
+enum class BlockDestroy { kObject, kBlock, kObjectAndBlock };
+
+// Blocks carry one destroy function instead of a vtable; it receives the concrete
+// block type statically, so releasing the last reference is a single indirect call. The
+// pointer takes the vptr's place, so this alone does not shrink a block. What it buys is a
+// standard-layout base that FromCounters can recover from the counters, and a block kind
+// that FromBase can recognise by comparing destroy functions.
+template <typename Policy = SingleThreaded>
 class ControlBlockBase {
 public:
+    using Destroyer = void (*)(ControlBlockBase*, BlockDestroy);
+
+    explicit ControlBlockBase(Destroyer destroyer) : destroyer_(destroyer) {
+    }
+
+    static ControlBlockBase* FromCounters(typename Policy::Counters* counters) {
+        static_assert(std::is_standard_layout_v<ControlBlockBase>);
+        return reinterpret_cast<ControlBlockBase*>(counters);
+    }
+
     size_t GetSCounter() const {
-        return shared_counter_;
+        return counters_.GetStrong();
     }
 
     size_t GetWCounter() const {
-        return weak_counter_;
+        return counters_.GetWeak() - (counters_.GetStrong() != 0);
     }
 
     void IncSCounter() {
-        ++shared_counter_;
+        counters_.IncStrong();
+        SMART_POINTERS_INSTRUMENT(Instrumentation::Add(stats_, &TypeStats::strong_increments);)
     }
 
     void IncWCounter() {
-        ++weak_counter_;
+        counters_.IncWeak();
+        SMART_POINTERS_INSTRUMENT(Instrumentation::Add(stats_, &TypeStats::weak_increments);)
     }
 
-    virtual void DeleteObject() {
+    bool TryIncSCounter() {
+        bool locked = counters_.TryIncStrong();
+        SMART_POINTERS_INSTRUMENT(Instrumentation::Add(
+            stats_, locked ? &TypeStats::strong_increments : &TypeStats::failed_locks);)
+        return locked;
     }
 
     void DecSCounter() {
-        if (shared_counter_ == 1) {
-            DeleteObject();
-            if (weak_counter_ == 0) {
-                delete this;
+        SMART_POINTERS_INSTRUMENT(Instrumentation::Add(stats_, &TypeStats::strong_decrements);)
+        ReleaseStrong(counters_.DecStrong());
+    }
+
+    Destroyer GetDestroyer() const {
+        return destroyer_;
+    }
+
+    void ReleaseStrong(StrongRelease release) {
+        switch (release) {
+            case StrongRelease::kAlive:
+                return;
+            case StrongRelease::kLastReference:
+                destroyer_(this, BlockDestroy::kObjectAndBlock);
+                return;
+            case StrongRelease::kLastStrong:
+                destroyer_(this, BlockDestroy::kObject);
+                DecWCounter();
                 return;
-            }
         }
-        --shared_counter_;
     }
 
     void DecWCounter() {
-        --weak_counter_;
-        if (weak_counter_ == 0 && shared_counter_ == 0) {
-            delete this;
+        SMART_POINTERS_INSTRUMENT(Instrumentation::Add(stats_, &TypeStats::weak_decrements);)
+        if (counters_.DecWeak()) {
+            destroyer_(this, BlockDestroy::kBlock);
         }
     }
 
-    virtual ~ControlBlockBase() = default;
+    TypeStats* Stats() const {
+        return stats_;
+    }
+
+#ifdef SMART_POINTERS_INSTRUMENTATION
+    void Track(TypeStats* stats) {
+        stats_ = stats;
+        Instrumentation::Created(stats);
+    }
+#endif
+
+protected:
+    ~ControlBlockBase() = default;
 
 private:
-    size_t shared_counter_ = 0;
-    size_t weak_counter_ = 0;
+    typename Policy::Counters counters_;
+    Destroyer destroyer_;
+    // Present in every build, so the block layout does not depend on the instrumentation flag.
+    TypeStats* stats_ = nullptr;
 };
 
-template <typename T>
-class ControlBlockPointer : public ControlBlockBase {
+template <typename T, typename Policy = SingleThreaded>
+class ControlBlockPointer : public ControlBlockBase<Policy> {
 public:
-    ControlBlockPointer(T* ptr) : ptr_(ptr) {
+    ControlBlockPointer(T* ptr) : ControlBlockBase<Policy>(&Destroy), ptr_(ptr) {
+        SMART_POINTERS_INSTRUMENT(this->Track(Instrumentation::For<T>());)
     }
 
     T* GetPointer() const {
         return ptr_;
     }
 
-    void DeleteObject() override {
-        delete ptr_;
+private:
+    static void Destroy(ControlBlockBase<Policy>* base, BlockDestroy what) {
+        auto self = static_cast<ControlBlockPointer*>(base);
+        if (what != BlockDestroy::kBlock) {
+            delete self->ptr_;
+            SMART_POINTERS_INSTRUMENT(Instrumentation::Destroyed(self->Stats());)
+        }
+        if (what != BlockDestroy::kObject) {
+            SMART_POINTERS_INSTRUMENT(Instrumentation::Deallocated(self->Stats());)
+            delete self;
+        }
     }
 
-    ~ControlBlockPointer() override = default;
-
-private:
     T* ptr_;
 };
 
-template <typename T>
-class ControlBlockHolder : public ControlBlockBase {
+template <typename T, typename Policy = SingleThreaded>
+class ControlBlockHolder : public ControlBlockBase<Policy> {
 public:
     template <typename... Args>
-    ControlBlockHolder(Args&&... args) {
+    ControlBlockHolder(Args&&... args) : ControlBlockBase<Policy>(&Destroy) {
         new (&storage_) T(std::forward<Args>(args)...);
+        SMART_POINTERS_INSTRUMENT(this->Track(Instrumentation::For<T>());)
     }
 
     T* GetPointer() {
         return reinterpret_cast<T*>(&storage_);
     }
 
-    void DeleteObject() override {
-        GetPointer()->~T();
+    // Recognises the block by its destroy function; returns null for any other kind.
+    static ControlBlockHolder* FromBase(ControlBlockBase<Policy>* base) {
+        if (base == nullptr || base->GetDestroyer() != &Destroy) {
+            return nullptr;
+        }
+        return static_cast<ControlBlockHolder*>(base);
     }
 
-    ~ControlBlockHolder() override = default;
-
 private:
+    static void Destroy(ControlBlockBase<Policy>* base, BlockDestroy what) {
+        auto self = static_cast<ControlBlockHolder*>(base);
+        if (what != BlockDestroy::kBlock) {
+            self->GetPointer()->~T();
+            SMART_POINTERS_INSTRUMENT(Instrumentation::Destroyed(self->Stats());)
+        }
+        if (what != BlockDestroy::kObject) {
+            SMART_POINTERS_INSTRUMENT(Instrumentation::Deallocated(self->Stats());)
+            delete self;
+        }
+    }
+
     std::aligned_storage_t<sizeof(T), alignof(T)> storage_;
 };
 
+template <typename T, typename Alloc, typename Policy = SingleThreaded>
+class ControlBlockAllocHolder : public ControlBlockBase<Policy> {
+    using ValueAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<T>;
+    using BlockAlloc =
+        typename std::allocator_traits<Alloc>::template rebind_alloc<ControlBlockAllocHolder>;
+    using Storage = std::aligned_storage_t<sizeof(T), alignof(T)>;
+
+public:
+    template <typename... Args>
+    ControlBlockAllocHolder(const Alloc& alloc, Args&&... args)
+        : ControlBlockBase<Policy>(&Destroy), data_(ValueAlloc(alloc)) {
+        std::allocator_traits<ValueAlloc>::construct(data_.GetFirst(), GetPointer(),
+                                                     std::forward<Args>(args)...);
+        SMART_POINTERS_INSTRUMENT(this->Track(Instrumentation::For<T>());)
+    }
+
+    template <typename... Args>
+    static ControlBlockAllocHolder* Create(const Alloc& alloc, Args&&... args) {
+        BlockAlloc block_alloc(alloc);
+        auto block = std::allocator_traits<BlockAlloc>::allocate(block_alloc, 1);
+        try {
+            return new (block) ControlBlockAllocHolder(alloc, std::forward<Args>(args)...);
+        } catch (...) {
+            std::allocator_traits<BlockAlloc>::deallocate(block_alloc, block, 1);
+            throw;
+        }
+    }
+
+    T* GetPointer() {
+        return reinterpret_cast<T*>(&data_.GetSecond());
+    }
+
+private:
+    static void Destroy(ControlBlockBase<Policy>* base, BlockDestroy what) {
+        auto self = static_cast<ControlBlockAllocHolder*>(base);
+        if (what != BlockDestroy::kBlock) {
+            std::allocator_traits<ValueAlloc>::destroy(self->data_.GetFirst(), self->GetPointer());
+            SMART_POINTERS_INSTRUMENT(Instrumentation::Destroyed(self->Stats());)
+        }
+        if (what != BlockDestroy::kObject) {
+            SMART_POINTERS_INSTRUMENT(Instrumentation::Deallocated(self->Stats());)
+            BlockAlloc block_alloc(self->data_.GetFirst());
+            self->~ControlBlockAllocHolder();
+            std::allocator_traits<BlockAlloc>::deallocate(block_alloc, self, 1);
+        }
+    }
+
+    CompressedPair<ValueAlloc, Storage> data_;
+};
+
+template <typename T, typename Alloc, typename Policy = SingleThreaded>
+class ControlBlockAllocPointer : public ControlBlockBase<Policy> {
+    using BlockAlloc =
+        typename std::allocator_traits<Alloc>::template rebind_alloc<ControlBlockAllocPointer>;
+
+public:
+    ControlBlockAllocPointer(const Alloc& alloc, T* ptr)
+        : ControlBlockBase<Policy>(&Destroy), data_(BlockAlloc(alloc), ptr) {
+        SMART_POINTERS_INSTRUMENT(this->Track(Instrumentation::For<T>());)
+    }
+
+    static ControlBlockAllocPointer* Create(const Alloc& alloc, T* ptr) {
+        BlockAlloc block_alloc(alloc);
+        try {
+            auto block = std::allocator_traits<BlockAlloc>::allocate(block_alloc, 1);
+            return new (block) ControlBlockAllocPointer(alloc, ptr);
+        } catch (...) {
+            delete ptr;
+            throw;
+        }
+    }
+
+    T* GetPointer() const {
+        return data_.GetSecond();
+    }
+
+private:
+    static void Destroy(ControlBlockBase<Policy>* base, BlockDestroy what) {
+        auto self = static_cast<ControlBlockAllocPointer*>(base);
+        if (what != BlockDestroy::kBlock) {
+            delete self->data_.GetSecond();
+            SMART_POINTERS_INSTRUMENT(Instrumentation::Destroyed(self->Stats());)
+        }
+        if (what != BlockDestroy::kObject) {
+            SMART_POINTERS_INSTRUMENT(Instrumentation::Deallocated(self->Stats());)
+            BlockAlloc block_alloc(self->data_.GetFirst());
+            self->~ControlBlockAllocPointer();
+            std::allocator_traits<BlockAlloc>::deallocate(block_alloc, self, 1);
+        }
+    }
+
+    CompressedPair<BlockAlloc, T*> data_;
+};
+
+template <typename T, typename Policy>
+class ControlBlockEpochHolder;
+
 template <typename T>
+class ControlBlockCollectableHolder;
+
+template <typename T, typename Policy = SingleThreaded>
 class SharedPtr;
 
+template <typename T, typename Policy = SingleThreaded>
+class WeakPtr;
+
 template <typename T>
-class WeakPtr;
\ No newline at end of file
+class AtomicSharedPtr;
+
+class CycleEdgeVisitor;
+
+template <typename T, typename Policy>
+class ThinSharedPtr;
+
+template <typename T, typename Policy>
+class ThinWeakPtr;
+
+template <typename T, typename Policy>
+class EpochSlot;
@@ -0,0 +1,63 @@
+#include "arena.h"
+#include "check.h"
+#include "weak.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+int live = 0;
+
+struct Node {
+    explicit Node(int v) : value(v) {
+        ++live;
+    }
+
+    ~Node() {
+        --live;
+    }
+
+    int value;
+};
+
+struct alignas(64) Wide {
+    char bytes[64];
+};
+
+void TestObjectsDieWithTheirLastReference() {
+    Arena arena;
+    SharedPtr<Node> first = MakeArenaShared<Node>(arena, 1);
+    WeakPtr<Node> weak = first;
+    SharedPtr<Node> second = MakeArenaShared<Node>(arena, 2);
+    CHECK(first->value + second->value == 3);
+    CHECK(live == 2);
+    first.Reset();
+    CHECK(live == 1);
+    CHECK(weak.Expired());
+    weak.Reset();
+    second.Reset();
+    CHECK(live == 0);
+    CHECK(arena.BytesAllocated() > 0);
+}
+
+void TestAlignmentAndLargeObjects() {
+    Arena arena(256);
+    std::vector<SharedPtr<Wide>> wide;
+    for (int i = 0; i < 16; ++i) {
+        wide.push_back(MakeArenaShared<Wide>(arena));
+        CHECK(reinterpret_cast<uintptr_t>(wide.back().Get()) % 64 == 0);
+    }
+    std::vector<int, ArenaAllocator<int>> numbers{ArenaAllocator<int>(arena)};
+    numbers.resize(1000, 7);
+    CHECK(numbers[999] == 7);
+    CHECK(arena.BytesAllocated() >= 1000 * sizeof(int));
+}
+
+}  // namespace
+
+int main() {
+    TestObjectsDieWithTheirLastReference();
+    TestAlignmentAndLargeObjects();
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include "atomic_shared.h"
+#include "check.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::atomic<int> live = 0;
+
+// Both halves are always written together, so a torn or freed snapshot shows up as a mismatch.
+struct Pair {
+    explicit Pair(int v) : first(v), second(v) {
+        ++live;
+    }
+
+    ~Pair() {
+        --live;
+    }
+
+    int first;
+    int second;
+};
+
+using Value = SharedPtr<Pair, MultiThreaded>;
+
+void TestLoadStoreExchange() {
+    {
+        AtomicSharedPtr<Pair> slot;
+        CHECK(slot.Load().Get() == nullptr);
+        slot.Store(MakeShared<Pair, MultiThreaded>(1));
+        Value loaded = slot.Load();
+        CHECK(loaded->first == 1);
+        CHECK(loaded.UseCount() == 2);
+        Value old = slot.Exchange(MakeShared<Pair, MultiThreaded>(2));
+        CHECK(old.Get() == loaded.Get());
+        CHECK(slot.Load()->first == 2);
+        old.Reset();
+        loaded.Reset();
+        CHECK(live == 1);
+    }
+    CHECK(live == 0);
+}
+
+void TestCompareExchange() {
+    AtomicSharedPtr<Pair> slot(MakeShared<Pair, MultiThreaded>(1));
+    Value expected = MakeShared<Pair, MultiThreaded>(7);
+    CHECK(!slot.CompareExchange(expected, MakeShared<Pair, MultiThreaded>(2)));
+    CHECK(expected->first == 1);
+    CHECK(slot.CompareExchange(expected, MakeShared<Pair, MultiThreaded>(3)));
+    CHECK(slot.Load()->first == 3);
+}
+
+void TestReadersAgainstWriters() {
+    {
+        AtomicSharedPtr<Pair> slot(MakeShared<Pair, MultiThreaded>(0));
+        std::atomic<bool> stop = false;
+        std::atomic<bool> torn = false;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back([&] {
+                while (!stop.load(std::memory_order_relaxed)) {
+                    Value value = slot.Load();
+                    if (value->first != value->second) {
+                        torn = true;
+                    }
+                }
+            });
+        }
+        for (int i = 0; i < 2; ++i) {
+            threads.emplace_back([&, i] {
+                for (int round = 1; round <= 20000; ++round) {
+                    slot.Store(MakeShared<Pair, MultiThreaded>(round * 2 + i));
+                }
+            });
+        }
+        for (size_t i = 4; i < threads.size(); ++i) {
+            threads[i].join();
+        }
+        stop = true;
+        for (size_t i = 0; i < 4; ++i) {
+            threads[i].join();
+        }
+        CHECK(!torn);
+        CHECK(live == 1);
+    }
+    CHECK(live == 0);
+}
+
+}  // namespace
+
+int main() {
+    TestLoadStoreExchange();
+    TestCompareExchange();
+    TestReadersAgainstWriters();
+    return 0;
+}
@@ -0,0 +1,88 @@
+#include "biased.h"
+#include "check.h"
+#include "shared.h"
+#include "weak.h"
+
+#include <atomic>
+#include <thread>
+
+namespace {
+
+std::atomic<int> live = 0;
+
+struct Node {
+    Node() {
+        ++live;
+    }
+
+    ~Node() {
+        --live;
+    }
+};
+
+using Ptr = SharedPtr<Node, Biased>;
+
+// The last reference is dropped by another thread, so the block waits in the owner's queue
+// with a total count of zero; nobody may lock it back to life in the meantime.
+void TestNoLockWhileQueued() {
+    Ptr owner = MakeShared<Node, Biased>();
+    WeakPtr<Node, Biased> weak = owner;
+    Ptr handed = owner;
+    owner.Reset();
+    std::thread([&] {
+        handed.Reset();
+        CHECK(weak.Expired());
+        CHECK(weak.Lock().Get() == nullptr);
+    }).join();
+    CHECK(weak.Expired());
+    CHECK(weak.Lock().Get() == nullptr);
+    CHECK(live == 1);
+    DrainBiasedMerges();
+    CHECK(live == 0);
+}
+
+void TestLockWhileReferenced() {
+    Ptr owner = MakeShared<Node, Biased>();
+    WeakPtr<Node, Biased> weak = owner;
+    std::thread([&] {
+        Ptr locked = weak.Lock();
+        CHECK(locked.Get() == owner.Get());
+        CHECK(locked.UseCount() == 2);
+    }).join();
+    owner.Reset();
+    DrainBiasedMerges();
+    CHECK(live == 0);
+}
+
+// Constructed before the thread's biased handle, so it is destroyed after it.
+struct LateOwner {
+    ~LateOwner() {
+        node.Reset();
+        Ptr late = MakeShared<Node, Biased>();
+        Ptr copy = late;
+        late.Reset();
+        copy.Reset();
+        DrainBiasedMerges();
+    }
+
+    Ptr node;
+};
+
+thread_local LateOwner late_owner;
+
+void TestReleaseAfterHandleDestroyed() {
+    std::thread([] {
+        LateOwner& owner = late_owner;
+        owner.node = MakeShared<Node, Biased>();
+    }).join();
+    CHECK(live == 0);
+}
+
+}  // namespace
+
+int main() {
+    TestNoLockWhileQueued();
+    TestLockWhileReferenced();
+    TestReleaseAfterHandleDestroyed();
+    return 0;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+// Tests are plain executables run by ctest; a failed check prints where and exits non-zero.
+#define CHECK(condition)                                                            \
+    do {                                                                            \
+        if (!(condition)) {                                                         \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__,   \
+                         #condition);                                               \
+            std::exit(1);                                                           \
+        }                                                                           \
+    } while (false)
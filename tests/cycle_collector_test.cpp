@@ -0,0 +1,124 @@
+#include "check.h"
+#include "cycle_collector.h"
+#include "weak.h"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace {
+
+int live = 0;
+
+struct Node {
+    Node() {
+        ++live;
+    }
+
+    ~Node() {
+        --live;
+    }
+
+    void TraceEdges(CycleEdgeVisitor& visitor) {
+        visitor(next);
+    }
+
+    SharedPtr<Node> next;
+};
+
+SharedPtr<Node> MakeRing(size_t size) {
+    SharedPtr<Node> head = MakeCollectable<Node>();
+    SharedPtr<Node> tail = head;
+    for (size_t i = 1; i < size; ++i) {
+        tail->next = MakeCollectable<Node>();
+        tail = tail->next;
+    }
+    tail->next = head;
+    return head;
+}
+
+void TestCollectsRings() {
+    for (int i = 0; i < 100; ++i) {
+        MakeRing(10);
+    }
+    CHECK(live == 1000);
+    CycleCollector::Global().Collect();
+    CHECK(live == 0);
+}
+
+// The only external reference moves around the ring between steps, so no single pass sees
+// it where it started; the ring must survive the collection intact.
+void TestMovingReferenceKeepsRingAlive() {
+    SharedPtr<Node> hand = MakeRing(1000);
+    CycleCollector& collector = CycleCollector::Global();
+    while (!collector.Step(std::chrono::nanoseconds(0))) {
+        for (int i = 0; i < 37; ++i) {
+            hand = hand->next;
+        }
+    }
+    CHECK(live == 1000);
+    SharedPtr<Node> walk = hand;
+    for (int i = 0; i < 1000; ++i) {
+        walk = walk->next;
+    }
+    CHECK(walk.Get() == hand.Get());
+    walk.Reset();
+    hand.Reset();
+    collector.Collect();
+    CHECK(live == 0);
+}
+
+// Every phase, including starting and releasing, gives control back within the budget, so
+// no single step grows with the number of tracked objects.
+void TestStepsStayBounded() {
+    using Clock = std::chrono::steady_clock;
+    std::vector<SharedPtr<Node>> roots;
+    for (int i = 0; i < 100000; ++i) {
+        roots.push_back(MakeCollectable<Node>());
+        MakeRing(2);
+    }
+    CycleCollector& collector = CycleCollector::Global();
+    Clock::duration longest{};
+    Clock::time_point begin = Clock::now();
+    bool done = false;
+    while (!done) {
+        Clock::time_point start = Clock::now();
+        done = collector.Step(std::chrono::nanoseconds(0));
+        longest = std::max(longest, Clock::now() - start);
+    }
+    Clock::duration total = Clock::now() - begin;
+    CHECK(live == 100000);
+    CHECK(longest * 10 < total);
+    roots.clear();
+    collector.Collect();
+    CHECK(live == 0);
+}
+
+// A dead object leaves the collector at once instead of keeping its block until a
+// collection gets round to it.
+void TestDeadObjectsAreForgotten() {
+    CycleCollector& collector = CycleCollector::Global();
+    size_t tracked = collector.TrackedCount();
+    SharedPtr<Node> ring = MakeRing(10);
+    WeakPtr<Node> weak = MakeCollectable<Node>();
+    CHECK(weak.Expired());
+    CHECK(collector.TrackedCount() == tracked + 10);
+    ring.Reset();
+    for (int i = 0; i < 100; ++i) {
+        MakeCollectable<Node>();
+    }
+    CHECK(collector.TrackedCount() == tracked + 10);
+    collector.Collect();
+    CHECK(collector.TrackedCount() == tracked);
+    CHECK(live == 0);
+}
+
+}  // namespace
+
+int main() {
+    TestCollectsRings();
+    TestMovingReferenceKeepsRingAlive();
+    TestStepsStayBounded();
+    TestDeadObjectsAreForgotten();
+    return 0;
+}
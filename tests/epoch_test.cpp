@@ -0,0 +1,120 @@
+#include "check.h"
+#include "epoch.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::atomic<int> live = 0;
+
+struct Snapshot {
+    Snapshot() : data(size_t(1) << 20) {
+        ++live;
+    }
+
+    ~Snapshot() {
+        --live;
+    }
+
+    std::vector<char> data;
+};
+
+// With no reader inside a guard, a replaced snapshot is reclaimed by the Store that
+// replaced it rather than after dozens more retirements.
+void TestStoreReclaimsSuperseded() {
+    EpochSlot<Snapshot> slot(MakeEpochShared<Snapshot>());
+    for (int i = 0; i < 10; ++i) {
+        slot.Store(MakeEpochShared<Snapshot>());
+        CHECK(live == 1);
+    }
+    {
+        EpochGuard guard;
+        Snapshot* borrowed = slot.Borrow(guard);
+        slot.Store(MakeEpochShared<Snapshot>());
+        CHECK(live == 2);
+        CHECK(borrowed->data.size() == size_t(1) << 20);
+    }
+    slot.Store(MakeEpochShared<Snapshot>());
+    CHECK(live == 1);
+}
+
+// A thread that drops the last reference and then retires nothing else still reclaims it.
+void TestOccasionalRetireIsCollected() {
+    EpochSlot<Snapshot> slot(MakeEpochShared<Snapshot>());
+    std::thread thread([&] {
+        auto copy = slot.Load();
+        copy.Reset();
+        slot.Store(MakeEpochShared<Snapshot>());
+        auto held = slot.Load();
+        slot.Store(MakeEpochShared<Snapshot>());
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        held.Reset();
+        CHECK(live == 1);
+    });
+    thread.join();
+}
+
+// Any other block would free its object inline, under a reader that borrowed it.
+void TestRejectsNonEpochBlocks() {
+    EpochSlot<Snapshot> slot(MakeEpochShared<Snapshot>());
+    Snapshot* published = slot.Load().Get();
+    bool thrown = false;
+    try {
+        slot.Store(MakeShared<Snapshot, MultiThreaded>());
+    } catch (const BadEpochPtr&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(slot.Load().Get() == published);
+    thrown = false;
+    try {
+        EpochSlot<Snapshot> other(SharedPtr<Snapshot, MultiThreaded>(new Snapshot));
+    } catch (const BadEpochPtr&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    slot.Store(nullptr);
+    CHECK(slot.Load().Get() == nullptr);
+    CHECK(live == 0);
+}
+
+// Constructed before the thread's participant, so it is destroyed after it.
+struct LateOwner {
+    ~LateOwner() {
+        {
+            EpochGuard guard;
+            Snapshot* borrowed = slot.Borrow(guard);
+            slot.Store(MakeEpochShared<Snapshot>());
+            CHECK(live == 2);
+            CHECK(borrowed->data.size() == size_t(1) << 20);
+        }
+        slot.Store(nullptr);
+        CHECK(live == 0);
+    }
+
+    EpochSlot<Snapshot> slot;
+};
+
+thread_local LateOwner late_owner;
+
+void TestRetireAfterParticipantDestroyed() {
+    std::thread([] {
+        LateOwner& owner = late_owner;
+        owner.slot.Store(MakeEpochShared<Snapshot>());
+        EpochGuard guard;
+    }).join();
+    CHECK(live == 0);
+}
+
+}  // namespace
+
+int main() {
+    TestStoreReclaimsSuperseded();
+    TestOccasionalRetireIsCollected();
+    TestRejectsNonEpochBlocks();
+    TestRetireAfterParticipantDestroyed();
+    return 0;
+}
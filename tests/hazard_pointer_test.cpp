@@ -0,0 +1,101 @@
+#include "check.h"
+#include "hazard_pointer.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::atomic<int> live = 0;
+
+struct Node : RefCounted<Node, MultiThreaded, HazardDelete<>> {
+    explicit Node(int v) : value(v) {
+        ++live;
+    }
+
+    ~Node() {
+        --live;
+    }
+
+    int value;
+};
+
+// A replaced node stays alive while a reader protects it and goes at the next scan after.
+void TestProtectedNodeOutlivesStore() {
+    HazardSlot<Node> slot(MakeIntrusive<Node>(1));
+    {
+        HazardPointer hazard;
+        Node* node = slot.Protect(hazard);
+        slot.Store(MakeIntrusive<Node>(2));
+        HazardDomain::Global().Scan();
+        CHECK(live == 2);
+        CHECK(node->value == 1);
+        hazard.Reset();
+        HazardDomain::Global().Scan();
+        CHECK(live == 1);
+    }
+    slot.Store(nullptr);
+    HazardDomain::Global().Scan();
+    CHECK(live == 0);
+}
+
+// Retire lists scan on their own once they grow, and a thread's leftovers are reclaimed
+// when it exits.
+void TestRetiredNodesAreReclaimed() {
+    HazardSlot<Node> slot(MakeIntrusive<Node>(0));
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&slot, t] {
+            HazardPointer hazard;
+            for (int i = 0; i < 1000; ++i) {
+                CHECK(slot.Protect(hazard)->value >= 0);
+                hazard.Reset();
+                slot.Store(MakeIntrusive<Node>(t * 1000 + i));
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    CHECK(live < 1000);
+    slot.Store(nullptr);
+    HazardDomain::Global().Scan();
+    CHECK(live == 0);
+}
+
+// Constructed before the thread's retire list, so it is destroyed after it.
+struct LateOwner {
+    ~LateOwner() {
+        HazardPointer hazard;
+        Node* node = slot.Protect(hazard);
+        slot.Store(MakeIntrusive<Node>(2));
+        CHECK(live == 2);
+        CHECK(node->value == 1);
+        hazard.Reset();
+        slot.Store(nullptr);
+        CHECK(live == 0);
+    }
+
+    HazardSlot<Node> slot;
+};
+
+thread_local LateOwner late_owner;
+
+void TestRetireAfterListDestroyed() {
+    std::thread([] {
+        LateOwner& owner = late_owner;
+        owner.slot.Store(MakeIntrusive<Node>(1));
+        HazardDomain::Global().Scan();
+    }).join();
+    CHECK(live == 0);
+}
+
+}  // namespace
+
+int main() {
+    TestProtectedNodeOutlivesStore();
+    TestRetiredNodesAreReclaimed();
+    TestRetireAfterListDestroyed();
+    return 0;
+}
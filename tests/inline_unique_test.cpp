@@ -0,0 +1,94 @@
+#include "check.h"
+#include "unique.h"
+
+#include <string>
+#include <utility>
+
+namespace {
+
+int live = 0;
+
+struct Strategy {
+    Strategy() {
+        ++live;
+    }
+
+    Strategy(const Strategy&) noexcept {
+        ++live;
+    }
+
+    virtual ~Strategy() {
+        --live;
+    }
+
+    virtual size_t Apply() const = 0;
+};
+
+struct Named : Strategy {
+    size_t Apply() const override {
+        return name.size();
+    }
+
+    std::string name = "a name that does not fit the small-string buffer";
+};
+
+struct Large : Strategy {
+    size_t Apply() const override {
+        return sizeof(bytes);
+    }
+
+    char bytes[256] = {};
+};
+
+struct ThrowingMove : Strategy {
+    ThrowingMove() = default;
+
+    ThrowingMove(ThrowingMove&& other) noexcept(false) : Strategy(other) {
+    }
+
+    size_t Apply() const override {
+        return 1;
+    }
+};
+
+// A strategy holding a std::string fits the default buffer.
+void TestSmallObjectsStayInline() {
+    {
+        auto ptr = MakeInlineUnique<Strategy, Named>();
+        CHECK(ptr.IsInline());
+        Strategy* before = ptr.Get();
+        InlineUniquePtr<Strategy> moved = std::move(ptr);
+        CHECK(!ptr);
+        CHECK(moved.IsInline());
+        CHECK(moved.Get() != before);
+        CHECK(moved->Apply() == Named().name.size());
+        CHECK(live == 1);
+    }
+    CHECK(live == 0);
+}
+
+void TestFallsBackToHeap() {
+    {
+        auto large = MakeInlineUnique<Strategy, Large>();
+        auto throwing = MakeInlineUnique<Strategy, ThrowingMove>();
+        CHECK(!large.IsInline());
+        CHECK(!throwing.IsInline());
+        Strategy* before = large.Get();
+        InlineUniquePtr<Strategy> moved = std::move(large);
+        CHECK(moved.Get() == before);
+        moved.Swap(throwing);
+        CHECK(moved->Apply() == 1);
+        CHECK(live == 2);
+        moved = nullptr;
+        CHECK(live == 1);
+    }
+    CHECK(live == 0);
+}
+
+}  // namespace
+
+int main() {
+    TestSmallObjectsStayInline();
+    TestFallsBackToHeap();
+    return 0;
+}
@@ -0,0 +1,136 @@
+// Built with SMART_POINTERS_INSTRUMENTATION, so every control block counts its operations.
+
+#include "check.h"
+#include "intrusive.h"
+#include "shared.h"
+#include "weak.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace {
+
+constexpr size_t kElements = 1000;
+
+struct Counts {
+    size_t strong_increments;
+    size_t strong_decrements;
+    size_t weak_increments;
+    size_t weak_decrements;
+    size_t copies;
+};
+
+template <typename T>
+Counts Read() {
+    TypeStats* stats = Instrumentation::For<T>();
+    return {stats->strong_increments.load(), stats->strong_decrements.load(),
+            stats->weak_increments.load(), stats->weak_decrements.load(), stats->copies.load()};
+}
+
+template <typename T>
+void CheckUnchanged(const Counts& before) {
+    Counts after = Read<T>();
+    CHECK(after.strong_increments == before.strong_increments);
+    CHECK(after.strong_decrements == before.strong_decrements);
+    CHECK(after.weak_increments == before.weak_increments);
+    CHECK(after.weak_decrements == before.weak_decrements);
+    CHECK(after.copies == before.copies);
+}
+
+struct SharedNode {
+    explicit SharedNode(int v) : value(v) {
+    }
+
+    int value;
+};
+
+struct WeakNode {
+    explicit WeakNode(int v) : value(v) {
+    }
+
+    int value;
+};
+
+struct IntrusiveNode : SimpleRefCounted<IntrusiveNode> {
+    explicit IntrusiveNode(int v) : value(v) {
+    }
+
+    int value;
+};
+
+void TestSharedPtrGrowth() {
+    Counts before = Read<SharedNode>();
+    size_t reallocations = 0;
+    std::vector<SharedPtr<SharedNode>> grown;
+    {
+        std::vector<SharedPtr<SharedNode>> source;
+        source.reserve(kElements);
+        for (size_t i = 0; i < kElements; ++i) {
+            source.push_back(MakeShared<SharedNode>(int(kElements - i)));
+        }
+        before = Read<SharedNode>();
+        for (SharedPtr<SharedNode>& p : source) {
+            size_t capacity = grown.capacity();
+            grown.push_back(std::move(p));
+            reallocations += grown.capacity() != capacity;
+        }
+        CheckUnchanged<SharedNode>(before);
+    }
+    CHECK(reallocations >= 5);
+    CheckUnchanged<SharedNode>(before);
+
+    std::sort(grown.begin(), grown.end(),
+              [](const auto& a, const auto& b) { return a->value < b->value; });
+    CheckUnchanged<SharedNode>(before);
+    CHECK(grown.front()->value == 1 && grown.back()->value == int(kElements));
+}
+
+void TestWeakPtrGrowth() {
+    std::vector<SharedPtr<WeakNode>> owners;
+    std::vector<WeakPtr<WeakNode>> source;
+    source.reserve(kElements);
+    for (size_t i = 0; i < kElements; ++i) {
+        owners.push_back(MakeShared<WeakNode>(int(i)));
+        source.push_back(owners.back());
+    }
+    Counts before = Read<WeakNode>();
+    std::vector<WeakPtr<WeakNode>> grown;
+    size_t reallocations = 0;
+    for (WeakPtr<WeakNode>& p : source) {
+        size_t capacity = grown.capacity();
+        grown.push_back(std::move(p));
+        reallocations += grown.capacity() != capacity;
+    }
+    CHECK(reallocations >= 5);
+    CheckUnchanged<WeakNode>(before);
+    CHECK(grown.back().Lock()->value == int(kElements - 1));
+}
+
+void TestIntrusivePtrGrowth() {
+    std::vector<IntrusivePtr<IntrusiveNode>> source;
+    source.reserve(kElements);
+    for (size_t i = 0; i < kElements; ++i) {
+        source.push_back(MakeIntrusive<IntrusiveNode>(int(i)));
+    }
+    Counts before = Read<IntrusiveNode>();
+    std::vector<IntrusivePtr<IntrusiveNode>> grown;
+    size_t reallocations = 0;
+    for (IntrusivePtr<IntrusiveNode>& p : source) {
+        size_t capacity = grown.capacity();
+        grown.push_back(std::move(p));
+        reallocations += grown.capacity() != capacity;
+    }
+    CHECK(reallocations >= 5);
+    CheckUnchanged<IntrusiveNode>(before);
+    CHECK(grown.back()->value == int(kElements - 1));
+}
+
+}  // namespace
+
+int main() {
+    TestSharedPtrGrowth();
+    TestWeakPtrGrowth();
+    TestIntrusivePtrGrowth();
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include "check.h"
+#include "refcount_log.h"
+
+#include <cstdint>
+#include <map>
+#include <thread>
+#include <vector>
+
+namespace {
+
+int live = 0;
+
+struct Node : DeferredRefCounted<Node> {
+    Node() {
+        ++live;
+    }
+
+    ~Node() {
+        --live;
+    }
+
+    IntrusivePtr<Node> child;
+};
+
+// Mirrors the log's direct-mapped slot choice, to line up colliding objects on purpose.
+size_t SlotOf(const void* object) {
+    return (reinterpret_cast<uintptr_t>(object) * 0x9e3779b97f4a7c15ull) >> 56;
+}
+
+// Constructed before the thread's log, so it is destroyed after it.
+struct LateOwner {
+    ~LateOwner() {
+        node.Reset();
+        CHECK(live == 0);
+    }
+
+    IntrusivePtr<Node> node;
+};
+
+thread_local LateOwner late_owner;
+
+void TestDropAfterLogDestroyed() {
+    std::thread thread([] {
+        LateOwner& owner = late_owner;
+        owner.node = MakeIntrusive<Node>();
+        IntrusivePtr<Node> copy = owner.node;
+        copy.Reset();
+        CHECK(owner.node->RefCount() == 2);
+    });
+    thread.join();
+    CHECK(live == 0);
+}
+
+void TestFlushAppliesPendingDrops() {
+    IntrusivePtr<Node> node = MakeIntrusive<Node>();
+    for (int i = 0; i < 10; ++i) {
+        IntrusivePtr<Node> copy = node;
+    }
+    node.Reset();
+    CHECK(live == 1);
+    RefCountLog::Flush();
+    CHECK(live == 0);
+}
+
+// Evicting b runs its destructor, which drops c into the very slot a is being written to.
+// Neither drop may be lost or credited to the wrong object.
+void TestEvictionThatDefersIntoSameSlot() {
+    std::vector<IntrusivePtr<Node>> pool;
+    std::map<size_t, std::vector<size_t>> by_slot;
+    std::vector<size_t>* colliding = nullptr;
+    while (colliding == nullptr) {
+        pool.push_back(MakeIntrusive<Node>());
+        std::vector<size_t>& same = by_slot[SlotOf(pool.back().Get())];
+        same.push_back(pool.size() - 1);
+        if (same.size() == 3) {
+            colliding = &same;
+        }
+    }
+    IntrusivePtr<Node>& a = pool[(*colliding)[0]];
+    IntrusivePtr<Node>& b = pool[(*colliding)[1]];
+    IntrusivePtr<Node>& c = pool[(*colliding)[2]];
+    b->child = std::move(c);
+    RefCountLog::Flush();
+    int before = live;
+    b.Reset();
+    IntrusivePtr<Node> copy = a;
+    copy.Reset();
+    RefCountLog::Flush();
+    CHECK(live == before - 2);
+    CHECK(a->RefCount() == 1);
+    pool.clear();
+    RefCountLog::Flush();
+    CHECK(live == 0);
+}
+
+// Bulk updates go through the log like single ones instead of bypassing it.
+void TestBulkUpdates() {
+    IntrusivePtr<Node> node = MakeIntrusive<Node>();
+    RefCountLog::Flush();
+    node->IncRef(3);
+    CHECK(node->RefCount() == 4);
+    node->DecRef(3);
+    CHECK(node->RefCount() == 4);
+    node->IncRef(2);
+    CHECK(node->RefCount() == 4);
+    RefCountLog::Flush();
+    CHECK(node->RefCount() == 3);
+    node->DecRef(2);
+    node.Reset();
+    CHECK(live == 1);
+    RefCountLog::Flush();
+    CHECK(live == 0);
+}
+
+}  // namespace
+
+int main() {
+    TestDropAfterLogDestroyed();
+    TestFlushAppliesPendingDrops();
+    TestEvictionThatDefersIntoSameSlot();
+    TestBulkUpdates();
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include "check.h"
+#include "relocation.h"
+
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+struct Counted : SimpleRefCounted<Counted> {};
+
+static_assert(IsTriviallyRelocatable<SharedPtr<int>>::value);
+static_assert(IsTriviallyRelocatable<UniquePtr<int>>::value);
+static_assert(IsTriviallyRelocatable<IntrusivePtr<Counted>>::value);
+static_assert(!IsTriviallyRelocatable<std::string>::value);
+
+int live = 0;
+int copies_left = -1;
+
+struct Tracked {
+    explicit Tracked(int v) : value(v) {
+        ++live;
+    }
+
+    Tracked(const Tracked& other) : value(other.value) {
+        if (copies_left >= 0 && copies_left-- == 0) {
+            throw std::runtime_error("copy");
+        }
+        ++live;
+    }
+
+    Tracked(Tracked&& other) noexcept : value(other.value) {
+        ++live;
+    }
+
+    Tracked& operator=(Tracked&& other) noexcept {
+        value = other.value;
+        return *this;
+    }
+
+    ~Tracked() {
+        --live;
+    }
+
+    int value;
+};
+
+// Growth copies the bytes, so no count is touched and every pointer keeps its object.
+void TestRelocatableGrowth() {
+    SharedPtr<int> shared = MakeShared<int>(5);
+    RelocatingVector<SharedPtr<int>> pointers;
+    for (int i = 0; i < 100; ++i) {
+        pointers.PushBack(shared);
+    }
+    CHECK(shared.UseCount() == 101);
+    pointers.Insert(0, MakeShared<int>(1));
+    pointers.Erase(50);
+    CHECK(*pointers[0] == 1);
+    CHECK(pointers.Size() == 100);
+    CHECK(shared.UseCount() == 100);
+    RelocatingVector<SharedPtr<int>> copy = pointers;
+    CHECK(shared.UseCount() == 199);
+    pointers.Clear();
+    copy.Clear();
+    CHECK(shared.UseCount() == 1);
+}
+
+void TestInsertEraseOrder() {
+    RelocatingVector<std::string> words;
+    words.PushBack("b");
+    words.PushBack("d");
+    words.Insert(0, "a");
+    words.Insert(2, "c");
+    words.Insert(4, "e");
+    std::string joined;
+    for (const std::string& word : words) {
+        joined += word;
+    }
+    CHECK(joined == "abcde");
+    words.Erase(1);
+    CHECK(words[1] == "c");
+    CHECK(words.Size() == 4);
+}
+
+void TestThrowingCopy() {
+    {
+        RelocatingVector<Tracked> items;
+        for (int i = 0; i < 8; ++i) {
+            items.EmplaceBack(i);
+        }
+        copies_left = 3;
+        bool thrown = false;
+        try {
+            RelocatingVector<Tracked> copy(items);
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        copies_left = -1;
+        CHECK(thrown);
+        CHECK(live == 8);
+    }
+    CHECK(live == 0);
+}
+
+}  // namespace
+
+int main() {
+    TestRelocatableGrowth();
+    TestInsertEraseOrder();
+    TestThrowingCopy();
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include "check.h"
+#include "shared.h"
+#include "weak.h"
+
+namespace {
+
+template <typename Policy>
+struct Observer : EnableSharedFromThis<Observer<Policy>, Policy> {
+    // Taken while the last strong reference is being released.
+    ~Observer() {
+        from_destructor = this->WeakFromThis();
+        try {
+            this->SharedFromThis();
+        } catch (const BadWeakPtr&) {
+            locked_in_destructor = false;
+        }
+    }
+
+    static inline WeakPtr<Observer, Policy> from_destructor;
+    static inline bool locked_in_destructor = true;
+};
+
+template <typename Policy>
+void TestWeakFromThisInDestructor() {
+    using Type = Observer<Policy>;
+    SharedPtr<Type, Policy> owner = MakeShared<Type, Policy>();
+    CHECK(owner->SharedFromThis().Get() == owner.Get());
+    CHECK(owner.UseCount() == 1);
+    owner.Reset();
+    CHECK(!Type::locked_in_destructor);
+    CHECK(Type::from_destructor.Expired());
+    CHECK(Type::from_destructor.Lock().Get() == nullptr);
+    Type::from_destructor.Reset();
+
+    SharedPtr<Type, Policy> pointer_owner(new Type);
+    WeakPtr<Type, Policy> weak = pointer_owner->WeakFromThis();
+    pointer_owner.Reset();
+    CHECK(weak.Expired());
+    CHECK(Type::from_destructor.Expired());
+    Type::from_destructor.Reset();
+}
+
+void TestUnownedObjectThrows() {
+    Observer<SingleThreaded> unowned;
+    bool thrown = false;
+    try {
+        unowned.SharedFromThis();
+    } catch (const BadWeakPtr&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(unowned.WeakFromThis().Expired());
+}
+
+}  // namespace
+
+int main() {
+    TestWeakFromThisInDestructor<SingleThreaded>();
+    TestWeakFromThisInDestructor<MultiThreaded>();
+    TestUnownedObjectThrows();
+    return 0;
+}
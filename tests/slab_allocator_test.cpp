@@ -0,0 +1,66 @@
+#include "check.h"
+#include "slab_allocator.h"
+
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Node {
+    explicit Node(int v) : value(v) {
+    }
+
+    int value;
+};
+
+// Constructed before the thread's magazine, so it is destroyed after it.
+struct LateOwner {
+    ~LateOwner() {
+        node.Reset();
+        node = MakePooledShared<Node>(2);
+        node.Reset();
+    }
+
+    SharedPtr<Node> node;
+};
+
+thread_local LateOwner late_owner;
+
+// Released by a static destructor, after the main thread's magazine is gone.
+SharedPtr<Node> static_owner;
+
+void TestReleaseAfterMagazine() {
+    std::thread thread([] {
+        LateOwner& owner = late_owner;
+        owner.node = MakePooledShared<Node>(1);
+        CHECK(owner.node->value == 1);
+    });
+    thread.join();
+}
+
+// MakePooledShared allocates whole control blocks, so their size class is the one to inspect.
+using BlockPool = SlabPoolFor<ControlBlockAllocHolder<Node, SlabAllocator<Node>>>;
+
+// Once the worker has exited, every slot it used sits in the depot until trimmed.
+void TestTrim() {
+    std::thread thread([] {
+        std::vector<SharedPtr<Node>> nodes;
+        for (int i = 0; i < 1000; ++i) {
+            nodes.push_back(MakePooledShared<Node>(i));
+        }
+    });
+    thread.join();
+    CHECK(BlockPool::GetStats().bytes_held > 0);
+    BlockPool::Trim();
+    CHECK(BlockPool::GetStats().bytes_held == 0);
+}
+
+}  // namespace
+
+int main() {
+    TestReleaseAfterMagazine();
+    TestTrim();
+    static_owner = MakePooledShared<Node>(3);
+    return 0;
+}
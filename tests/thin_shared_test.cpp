@@ -0,0 +1,101 @@
+#include "check.h"
+#include "thin_shared.h"
+
+#include <utility>
+
+namespace {
+
+int live = 0;
+
+struct Pair {
+    Pair(int a, int b) : first(a), second(b) {
+        ++live;
+    }
+
+    ~Pair() {
+        --live;
+    }
+
+    int first;
+    int second;
+};
+
+static_assert(sizeof(ThinSharedPtr<Pair>) == sizeof(void*));
+static_assert(sizeof(ThinWeakPtr<Pair>) == sizeof(void*));
+
+void TestSharedRoundTrip() {
+    {
+        ThinSharedPtr<Pair> thin = MakeThinShared<Pair>(1, 2);
+        SharedPtr<Pair> shared = thin;
+        CHECK(shared.Get() == thin.Get());
+        CHECK(thin.UseCount() == 2);
+        ThinSharedPtr<Pair> back(shared);
+        CHECK(back.Get() == thin.Get());
+        CHECK(thin.UseCount() == 3);
+        SharedPtr<Pair> moved = std::move(back);
+        CHECK(!back);
+        CHECK(thin.UseCount() == 3);
+    }
+    CHECK(live == 0);
+}
+
+void TestWeakConversions() {
+    {
+        SharedPtr<Pair> shared = MakeShared<Pair>(3, 4);
+        WeakPtr<Pair> weak = shared;
+        ThinWeakPtr<Pair> from_weak(weak);
+        ThinWeakPtr<Pair> from_shared(shared);
+        CHECK(from_weak.UseCount() == 1);
+        CHECK(from_weak.Lock().Get() == shared.Get());
+        CHECK(from_shared.Lock()->second == 4);
+        WeakPtr<Pair> back = from_shared;
+        CHECK(back.Lock().Get() == shared.Get());
+        shared.Reset();
+        CHECK(live == 0);
+        CHECK(from_weak.Expired());
+        CHECK(back.Expired());
+        CHECK(ThinWeakPtr<Pair>(weak).Expired());
+        CHECK(!from_shared.Lock());
+    }
+    ThinWeakPtr<Pair> empty{WeakPtr<Pair>()};
+    CHECK(empty.Expired());
+    CHECK(static_cast<WeakPtr<Pair>>(empty).Expired());
+}
+
+// Pointers whose object does not live in a MakeShared block, or that are aliased, cannot be
+// made thin in either direction.
+void TestRejectsOtherBlocks() {
+    SharedPtr<Pair> separate(new Pair(5, 6));
+    SharedPtr<Pair> combined = MakeShared<Pair>(7, 8);
+    SharedPtr<Pair> aliased(combined, separate.Get());
+    int thrown = 0;
+    try {
+        ThinSharedPtr<Pair> thin(separate);
+    } catch (const BadThinPtr&) {
+        ++thrown;
+    }
+    try {
+        ThinWeakPtr<Pair> thin{WeakPtr<Pair>(separate)};
+    } catch (const BadThinPtr&) {
+        ++thrown;
+    }
+    try {
+        ThinWeakPtr<Pair> thin(aliased);
+    } catch (const BadThinPtr&) {
+        ++thrown;
+    }
+    CHECK(thrown == 3);
+    CHECK(separate.UseCount() == 1);
+    CHECK(combined.UseCount() == 2);
+    CHECK(combined->first == 7);
+}
+
+}  // namespace
+
+int main() {
+    TestSharedRoundTrip();
+    TestWeakConversions();
+    TestRejectsOtherBlocks();
+    CHECK(live == 0);
+    return 0;
+}
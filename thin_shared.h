@@ -0,0 +1,235 @@
+#pragma once
+
+#include "shared.h"
+#include "weak.h"
+
+#include <cstddef>
+#include <exception>
+#include <utility>
+
+class BadThinPtr : public std::exception {};
+
+// One word instead of two: the object lives inside its ControlBlockHolder, so its address
+// is derived from the block. Only non-aliased pointers to exactly T created by MakeShared
+// (or MakeThinShared) can be made thin; converting anything else throws BadThinPtr.
+template <typename T, typename Policy = SingleThreaded>
+class ThinSharedPtr {
+    using Block = ControlBlockHolder<T, Policy>;
+
+public:
+
+    ThinSharedPtr() noexcept = default;
+
+    ThinSharedPtr(std::nullptr_t) noexcept {
+    }
+
+    explicit ThinSharedPtr(const SharedPtr<T, Policy>& other)
+        : block_(Adopt(other.ptr_, other.block_)) {
+        if (block_ != nullptr) {
+            block_->IncSCounter();
+        }
+    }
+
+    explicit ThinSharedPtr(SharedPtr<T, Policy>&& other)
+        : block_(Adopt(other.ptr_, other.block_)) {
+        other.ptr_ = nullptr;
+        other.block_ = nullptr;
+    }
+
+    ThinSharedPtr(const ThinSharedPtr& other) : block_(other.block_) {
+        if (block_ != nullptr) {
+            block_->IncSCounter();
+        }
+    }
+
+    ThinSharedPtr(ThinSharedPtr&& other) noexcept : block_(std::exchange(other.block_, nullptr)) {
+    }
+
+    ThinSharedPtr& operator=(const ThinSharedPtr& other) {
+        ThinSharedPtr(other).Swap(*this);
+        return *this;
+    }
+
+    ThinSharedPtr& operator=(ThinSharedPtr&& other) noexcept {
+        ThinSharedPtr(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    ThinSharedPtr& operator=(std::nullptr_t) noexcept {
+        Reset();
+        return *this;
+    }
+
+    ~ThinSharedPtr() {
+        if (block_ != nullptr) {
+            block_->DecSCounter();
+        }
+    }
+
+    operator SharedPtr<T, Policy>() const& {
+        SharedPtr<T, Policy> result;
+        if (block_ != nullptr) {
+            block_->IncSCounter();
+            result.ptr_ = block_->GetPointer();
+            result.block_ = block_;
+        }
+        return result;
+    }
+
+    operator SharedPtr<T, Policy>() && {
+        SharedPtr<T, Policy> result;
+        if (block_ != nullptr) {
+            result.ptr_ = block_->GetPointer();
+            result.block_ = std::exchange(block_, nullptr);
+        }
+        return result;
+    }
+
+    void Reset() noexcept {
+        ThinSharedPtr().Swap(*this);
+    }
+
+    void Swap(ThinSharedPtr& other) noexcept {
+        std::swap(block_, other.block_);
+    }
+
+    T* Get() const {
+        return block_ != nullptr ? block_->GetPointer() : nullptr;
+    }
+
+    T& operator*() const {
+        return *block_->GetPointer();
+    }
+
+    T* operator->() const {
+        return block_->GetPointer();
+    }
+
+    size_t UseCount() const {
+        if (block_ == nullptr) {
+            return 0;
+        }
+        return block_->GetSCounter();
+    }
+
+    explicit operator bool() const {
+        return block_ != nullptr;
+    }
+
+private:
+    static Block* Adopt(T* ptr, ControlBlockBase<Policy>* base) {
+        if (base == nullptr && ptr == nullptr) {
+            return nullptr;
+        }
+        Block* block = Block::FromBase(base);
+        if (block == nullptr || block->GetPointer() != ptr) {
+            throw BadThinPtr();
+        }
+        return block;
+    }
+
+    Block* block_ = nullptr;
+
+    template <typename Y, typename P>
+    friend class ThinWeakPtr;
+};
+
+template <typename T, typename Policy = SingleThreaded>
+class ThinWeakPtr {
+    using Block = ControlBlockHolder<T, Policy>;
+
+public:
+
+    ThinWeakPtr() noexcept = default;
+
+    ThinWeakPtr(const ThinSharedPtr<T, Policy>& other) : block_(other.block_) {
+        if (block_ != nullptr) {
+            block_->IncWCounter();
+        }
+    }
+
+    // The same rules as for ThinSharedPtr apply, and an expired WeakPtr converts too.
+    explicit ThinWeakPtr(const WeakPtr<T, Policy>& other)
+        : block_(ThinSharedPtr<T, Policy>::Adopt(other.ptr_, other.block_)) {
+        if (block_ != nullptr) {
+            block_->IncWCounter();
+        }
+    }
+
+    explicit ThinWeakPtr(const SharedPtr<T, Policy>& other)
+        : block_(ThinSharedPtr<T, Policy>::Adopt(other.ptr_, other.block_)) {
+        if (block_ != nullptr) {
+            block_->IncWCounter();
+        }
+    }
+
+    ThinWeakPtr(const ThinWeakPtr& other) : block_(other.block_) {
+        if (block_ != nullptr) {
+            block_->IncWCounter();
+        }
+    }
+
+    ThinWeakPtr(ThinWeakPtr&& other) noexcept : block_(std::exchange(other.block_, nullptr)) {
+    }
+
+    ThinWeakPtr& operator=(const ThinWeakPtr& other) {
+        ThinWeakPtr(other).Swap(*this);
+        return *this;
+    }
+
+    ThinWeakPtr& operator=(ThinWeakPtr&& other) noexcept {
+        ThinWeakPtr(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    ~ThinWeakPtr() {
+        if (block_ != nullptr) {
+            block_->DecWCounter();
+        }
+    }
+
+    operator WeakPtr<T, Policy>() const {
+        WeakPtr<T, Policy> result;
+        if (block_ != nullptr) {
+            block_->IncWCounter();
+            result.ptr_ = block_->GetPointer();
+            result.block_ = block_;
+        }
+        return result;
+    }
+
+    void Reset() noexcept {
+        ThinWeakPtr().Swap(*this);
+    }
+
+    void Swap(ThinWeakPtr& other) noexcept {
+        std::swap(block_, other.block_);
+    }
+
+    size_t UseCount() const {
+        if (block_ == nullptr) {
+            return 0;
+        }
+        return block_->GetSCounter();
+    }
+
+    bool Expired() const {
+        return UseCount() == 0;
+    }
+
+    ThinSharedPtr<T, Policy> Lock() const {
+        ThinSharedPtr<T, Policy> result;
+        if (block_ != nullptr && block_->TryIncSCounter()) {
+            result.block_ = block_;
+        }
+        return result;
+    }
+
+private:
+    Block* block_ = nullptr;
+};
+
+template <typename T, typename Policy = SingleThreaded, typename... Args>
+ThinSharedPtr<T, Policy> MakeThinShared(Args&&... args) {
+    return ThinSharedPtr<T, Policy>(MakeShared<T, Policy>(std::forward<Args>(args)...));
+}
@@ -2,7 +2,10 @@
 
 #include "compressed_pair.h"
 #include <cstddef>
+#include <cstdint>
+#include <new>
 #include <type_traits>
+#include <utility>
 
 template <typename T>
 struct DefaultDeleter {
@@ -313,4 +316,189 @@ public:
 
 private:
     CompressedPair<void*, Deleter> data_;
-};
\ No newline at end of file
+};
+
+// Keeps objects that fit into N bytes inline and falls back to the heap otherwise, silently.
+// The default of 48 makes the whole pointer one 64-byte cache line and still fits a
+// polymorphic object holding a std::string (a vtable pointer plus 32 bytes in libstdc++).
+// An inline object is relocated by its move constructor when the pointer moves, so it must
+// be nothrow-movable to be stored inline.
+template <typename Base, size_t N = 48>
+class InlineUniquePtr {
+public:
+
+    InlineUniquePtr() noexcept = default;
+
+    InlineUniquePtr(std::nullptr_t) noexcept {
+    }
+
+    InlineUniquePtr(InlineUniquePtr&& other) noexcept {
+        MoveFrom(other);
+    }
+
+    InlineUniquePtr& operator=(InlineUniquePtr&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            MoveFrom(other);
+        }
+        return *this;
+    }
+
+    InlineUniquePtr& operator=(std::nullptr_t) noexcept {
+        Reset();
+        return *this;
+    }
+
+    ~InlineUniquePtr() {
+        Reset();
+    }
+
+    template <typename D, typename... Args>
+    void Emplace(Args&&... args) {
+        static_assert(std::is_convertible_v<D*, Base*>);
+        Reset();
+        if constexpr (kFitsInline<D>) {
+            ptr_ = new (&buffer_) D(std::forward<Args>(args)...);
+            ops_ = &kInlineOps<D>;
+        } else {
+            ptr_ = new D(std::forward<Args>(args)...);
+            ops_ = &kHeapOps<D>;
+        }
+    }
+
+    void Reset() noexcept {
+        if (ptr_ != nullptr) {
+            ops_->destroy(ptr_);
+            ptr_ = nullptr;
+            ops_ = nullptr;
+        }
+    }
+
+    void Swap(InlineUniquePtr& other) noexcept {
+        InlineUniquePtr tmp(std::move(other));
+        other = std::move(*this);
+        *this = std::move(tmp);
+    }
+
+    Base* Get() const {
+        return ptr_;
+    }
+
+    Base& operator*() const {
+        return *ptr_;
+    }
+
+    Base* operator->() const {
+        return ptr_;
+    }
+
+    explicit operator bool() const {
+        return ptr_ != nullptr;
+    }
+
+    bool IsInline() const {
+        return ops_ != nullptr && ops_->relocate != nullptr;
+    }
+
+private:
+    struct Ops {
+        void (*destroy)(Base* object);
+        Base* (*relocate)(Base* from, void* to);
+    };
+
+    template <typename D>
+    static constexpr bool kFitsInline = sizeof(D) <= N && alignof(D) <= alignof(std::max_align_t) &&
+                                        std::is_nothrow_move_constructible_v<D>;
+
+    template <typename D>
+    static void DestroyInline(Base* object) {
+        static_cast<D*>(object)->~D();
+    }
+
+    template <typename D>
+    static void DestroyHeap(Base* object) {
+        delete static_cast<D*>(object);
+    }
+
+    template <typename D>
+    static Base* Relocate(Base* from, void* to) {
+        auto source = static_cast<D*>(from);
+        Base* result = new (to) D(std::move(*source));
+        source->~D();
+        return result;
+    }
+
+    template <typename D>
+    static constexpr Ops kInlineOps{&DestroyInline<D>, &Relocate<D>};
+
+    template <typename D>
+    static constexpr Ops kHeapOps{&DestroyHeap<D>, nullptr};
+
+    void MoveFrom(InlineUniquePtr& other) noexcept {
+        if (other.ptr_ == nullptr) {
+            return;
+        }
+        ops_ = other.ops_;
+        ptr_ = ops_->relocate != nullptr ? ops_->relocate(other.ptr_, &buffer_) : other.ptr_;
+        other.ptr_ = nullptr;
+        other.ops_ = nullptr;
+    }
+
+    Base* ptr_ = nullptr;
+    const Ops* ops_ = nullptr;
+    std::aligned_storage_t<N, alignof(std::max_align_t)> buffer_;
+};
+
+template <typename Base, typename D, size_t N = 48, typename... Args>
+InlineUniquePtr<Base, N> MakeInlineUnique(Args&&... args) {
+    InlineUniquePtr<Base, N> result;
+    result.template Emplace<D>(std::forward<Args>(args)...);
+    return result;
+}
+
+// Frees arrays from MakeUniqueAlignedForOverwrite. Elements are never destroyed, so only
+// trivially destructible types are accepted; being empty, it adds nothing to UniquePtr.
+template <typename T, size_t Alignment>
+struct AlignedArrayDeleter {
+    static_assert(std::is_trivially_destructible_v<T>);
+    static_assert(Alignment != 0 && (Alignment & (Alignment - 1)) == 0);
+
+    void operator()(T* ptr) const {
+        ::operator delete[](ptr, std::align_val_t(Alignment));
+    }
+};
+
+// Leaves elements default-initialized, i.e. uninitialized for trivial types.
+template <typename T>
+std::enable_if_t<!std::is_array_v<T>, UniquePtr<T>> MakeUniqueForOverwrite() {
+    return UniquePtr<T>(new T);
+}
+
+template <typename T>
+std::enable_if_t<std::is_array_v<T> && std::extent_v<T> == 0, UniquePtr<T>>
+MakeUniqueForOverwrite(size_t n) {
+    return UniquePtr<T>(new std::remove_extent_t<T>[n]);
+}
+
+template <typename T, size_t Alignment>
+std::enable_if_t<std::is_array_v<T> && std::extent_v<T> == 0,
+                 UniquePtr<T, AlignedArrayDeleter<std::remove_extent_t<T>, Alignment>>>
+MakeUniqueAlignedForOverwrite(size_t n) {
+    using Element = std::remove_extent_t<T>;
+    static_assert(Alignment >= alignof(Element));
+    if (n > SIZE_MAX / sizeof(Element)) {
+        throw std::bad_array_new_length();
+    }
+    auto ptr = static_cast<Element*>(
+        ::operator new[](n * sizeof(Element), std::align_val_t(Alignment)));
+    // Elements are trivially destructible, so a throwing constructor only leaves the storage.
+    try {
+        for (size_t i = 0; i < n; ++i) {
+            new (ptr + i) Element;
+        }
+    } catch (...) {
+        AlignedArrayDeleter<Element, Alignment>()(ptr);
+        throw;
+    }
+    return UniquePtr<T, AlignedArrayDeleter<Element, Alignment>>(ptr);
+}
@@ -4,11 +4,11 @@
 
 #include <cassert>
 
-template <typename T>
+template <typename T, typename Policy>
 class WeakPtr {
 public:
 
-    WeakPtr() : ptr_(nullptr), block_(nullptr) {
+    WeakPtr() noexcept : ptr_(nullptr), block_(nullptr) {
     }
 
     WeakPtr(const WeakPtr& other) : ptr_(other.ptr_), block_(other.block_) {
@@ -17,65 +17,56 @@ public:
         }
     }
 
-    WeakPtr(WeakPtr&& other) {
-        ptr_ = std::move(other.ptr_);
-        block_ = std::move(other.block_);
+    template <typename Y>
+    WeakPtr(const WeakPtr<Y, Policy>& other) : ptr_(other.ptr_), block_(other.block_) {
+        if (block_ != nullptr) {
+            block_->IncWCounter();
+        }
+    }
+
+    WeakPtr(WeakPtr&& other) noexcept : ptr_(other.ptr_), block_(other.block_) {
+        other.ptr_ = nullptr;
+        other.block_ = nullptr;
+    }
+
+    template <typename Y>
+    WeakPtr(WeakPtr<Y, Policy>&& other) noexcept : ptr_(other.ptr_), block_(other.block_) {
         other.ptr_ = nullptr;
         other.block_ = nullptr;
     }
 
-    WeakPtr(const SharedPtr<T>& other) : ptr_(other.ptr_), block_(other.block_) {
+    template <typename Y>
+    WeakPtr(const SharedPtr<Y, Policy>& other) : ptr_(other.ptr_), block_(other.block_) {
         if (block_ != nullptr) {
             block_->IncWCounter();
         }
     }
 
     WeakPtr& operator=(const WeakPtr& other) {
-        if (block_ != nullptr) {
-            block_->DecWCounter();
-        }
-        ptr_ = other.ptr_;
-        block_ = other.block_;
-        if (block_ != nullptr) {
-            block_->IncWCounter();
-        }
+        WeakPtr(other).Swap(*this);
         return *this;
     }
 
     template <typename Y>
-    WeakPtr& operator=(const WeakPtr<Y>& other) {
-        if (block_ != nullptr) {
-            block_->DecWCounter();
-        }
-        ptr_ = other.ptr_;
-        block_ = other.block_;
-        if (block_ != nullptr) {
-            block_->IncWCounter();
-        }
+    WeakPtr& operator=(const WeakPtr<Y, Policy>& other) {
+        WeakPtr(other).Swap(*this);
         return *this;
     }
 
-    WeakPtr& operator=(WeakPtr&& other) {
-        if (block_ != nullptr) {
-            block_->DecWCounter();
-        }
-        ptr_ = std::move(other.ptr_);
-        block_ = std::move(other.block_);
-        other.ptr_ = nullptr;
-        other.block_ = nullptr;
+    WeakPtr& operator=(WeakPtr&& other) noexcept {
+        WeakPtr(std::move(other)).Swap(*this);
         return *this;
     }
 
     template <typename Y>
-    WeakPtr& operator=(SharedPtr<Y>& other) {
-        if (block_ != nullptr) {
-            block_->DecWCounter();
-        }
-        ptr_ = other.ptr_;
-        block_ = other.block_;
-        if (block_ != nullptr) {
-            block_->IncWCounter();
-        }
+    WeakPtr& operator=(WeakPtr<Y, Policy>&& other) noexcept {
+        WeakPtr(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    template <typename Y>
+    WeakPtr& operator=(const SharedPtr<Y, Policy>& other) {
+        WeakPtr(other).Swap(*this);
         return *this;
     }
 
@@ -86,16 +77,11 @@ public:
         block_->DecWCounter();
     }
 
-    void Reset() {
-        if (block_ == nullptr) {
-            return;
-        }
-        block_->DecWCounter();
-        ptr_ = nullptr;
-        block_ = nullptr;
+    void Reset() noexcept {
+        WeakPtr().Swap(*this);
     }
 
-    void Swap(WeakPtr& other) {
+    void Swap(WeakPtr& other) noexcept {
         std::swap(ptr_, other.ptr_);
         std::swap(block_, other.block_);
     }
@@ -114,20 +100,28 @@ public:
         return block_->GetSCounter() == 0;
     }
 
-    SharedPtr<T> Lock() const {
-        if (UseCount() == 0) {
-            return SharedPtr<T>();
+    SharedPtr<T, Policy> Lock() const {
+        SharedPtr<T, Policy> result;
+        if (block_ != nullptr && block_->TryIncSCounter()) {
+            result.ptr_ = ptr_;
+            result.block_ = block_;
         }
-        return SharedPtr(*this);
+        return result;
     }
 
 private:
     T* ptr_ = nullptr;
-    ControlBlockBase* block_ = nullptr;
+    ControlBlockBase<Policy>* block_ = nullptr;
 
-    template <typename Y>
+    template <typename Y, typename P>
     friend class SharedPtr;
 
-    template <typename Y>
+    template <typename Y, typename P>
     friend class WeakPtr;
+
+    template <typename Y, typename P>
+    friend class EnableSharedFromThis;
+
+    template <typename Y, typename P>
+    friend class ThinWeakPtr;
 };